@@ -0,0 +1,225 @@
+#ifndef BUILD_FIELDS_HPP
+#define BUILD_FIELDS_HPP
+
+#include <array>
+#include <cstdint>
+#include <string_view>
+
+// 可伪装的 android.os.Build / Build.VERSION 静态字段.
+// Companion 在加载配置时据此为每个键确定类与 JNI 类型并预先解析取值, app 进程只按记录直接设置.
+namespace BuildFields {
+
+enum FieldClass : uint8_t {
+    CLASS_BUILD = 0,
+    CLASS_VERSION = 1,
+    CLASS_COUNT,
+};
+
+enum FieldType : uint8_t {
+    TYPE_STRING = 0,
+    TYPE_INT = 1,
+    TYPE_LONG = 2,
+    TYPE_BOOLEAN = 3,
+    TYPE_STRING_ARRAY = 4,
+    TYPE_COUNT,
+};
+
+struct Descriptor {
+    std::string_view name;
+    FieldClass fieldClass;
+    FieldType type;
+    int minSdk; // 低于此 API 级别的系统没有该字段
+};
+
+constexpr const char* CLASS_NAMES[CLASS_COUNT] = {
+    "android/os/Build",
+    "android/os/Build$VERSION",
+};
+
+constexpr Descriptor DESCRIPTORS[] = {
+    {"BOARD", CLASS_BUILD, TYPE_STRING, 1},
+    {"BOOTLOADER", CLASS_BUILD, TYPE_STRING, 8},
+    {"BRAND", CLASS_BUILD, TYPE_STRING, 4},
+    {"CPU_ABI", CLASS_BUILD, TYPE_STRING, 4},
+    {"CPU_ABI2", CLASS_BUILD, TYPE_STRING, 8},
+    {"DEVICE", CLASS_BUILD, TYPE_STRING, 1},
+    {"DISPLAY", CLASS_BUILD, TYPE_STRING, 3},
+    {"FINGERPRINT", CLASS_BUILD, TYPE_STRING, 1},
+    {"HARDWARE", CLASS_BUILD, TYPE_STRING, 8},
+    {"HOST", CLASS_BUILD, TYPE_STRING, 1},
+    {"ID", CLASS_BUILD, TYPE_STRING, 1},
+    {"MANUFACTURER", CLASS_BUILD, TYPE_STRING, 4},
+    {"MODEL", CLASS_BUILD, TYPE_STRING, 1},
+    {"ODM_SKU", CLASS_BUILD, TYPE_STRING, 31},
+    {"PRODUCT", CLASS_BUILD, TYPE_STRING, 1},
+    {"RADIO", CLASS_BUILD, TYPE_STRING, 8},
+    {"SERIAL", CLASS_BUILD, TYPE_STRING, 9},
+    {"SKU", CLASS_BUILD, TYPE_STRING, 31},
+    {"SOC_MANUFACTURER", CLASS_BUILD, TYPE_STRING, 31},
+    {"SOC_MODEL", CLASS_BUILD, TYPE_STRING, 31},
+    {"TAGS", CLASS_BUILD, TYPE_STRING, 1},
+    {"TYPE", CLASS_BUILD, TYPE_STRING, 1},
+    {"USER", CLASS_BUILD, TYPE_STRING, 1},
+    {"TIME", CLASS_BUILD, TYPE_LONG, 1},
+    {"IS_DEBUGGABLE", CLASS_BUILD, TYPE_BOOLEAN, 16},
+    {"SUPPORTED_ABIS", CLASS_BUILD, TYPE_STRING_ARRAY, 21},
+    {"SUPPORTED_32_BIT_ABIS", CLASS_BUILD, TYPE_STRING_ARRAY, 21},
+    {"SUPPORTED_64_BIT_ABIS", CLASS_BUILD, TYPE_STRING_ARRAY, 21},
+    {"BASE_OS", CLASS_VERSION, TYPE_STRING, 23},
+    {"CODENAME", CLASS_VERSION, TYPE_STRING, 4},
+    {"INCREMENTAL", CLASS_VERSION, TYPE_STRING, 1},
+    {"RELEASE", CLASS_VERSION, TYPE_STRING, 1},
+    {"RELEASE_OR_CODENAME", CLASS_VERSION, TYPE_STRING, 30},
+    {"RELEASE_OR_PREVIEW_DISPLAY", CLASS_VERSION, TYPE_STRING, 33},
+    {"SDK", CLASS_VERSION, TYPE_STRING, 1},
+    {"SECURITY_PATCH", CLASS_VERSION, TYPE_STRING, 23},
+    {"SDK_INT", CLASS_VERSION, TYPE_INT, 4},
+    {"PREVIEW_SDK_INT", CLASS_VERSION, TYPE_INT, 23},
+    {"MEDIA_PERFORMANCE_CLASS", CLASS_VERSION, TYPE_INT, 31},
+};
+
+// Build 字段对应的系统属性 (Build 在类初始化时从这些属性读取). 模式中的 "{}" 依次替换为
+// PARTITIONS 中的分区名, 生成各分区的变体; Companion 只保留本机实际存在的属性.
+//
+// 以下属性决定 app 进程中的运行时行为 (HAL 与 native 库的选择, API 级别判断, 调试权限), 伪装后
+// 可能导致崩溃, 因此不派生, 需要时只能在 props 中显式给出: ro.build.version.sdk (含各分区变体),
+// ro.hardware, ro.boot.hardware, ro.product.board, ro.product.cpu.abilist*, ro.debuggable
+struct PropertyDerivation {
+    std::string_view field;
+    std::string_view pattern;
+};
+
+constexpr std::string_view PARTITIONS[] = {
+    "bootimage", "odm", "odm_dlkm", "product", "system", "system_dlkm", "system_ext", "vendor", "vendor_dlkm",
+};
+
+constexpr PropertyDerivation PROPERTY_DERIVATIONS[] = {
+    {"BOOTLOADER", "ro.bootloader"},
+    {"BOOTLOADER", "ro.boot.bootloader"},
+    {"BRAND", "ro.product.brand"},
+    {"BRAND", "ro.product.{}.brand"},
+    {"CPU_ABI", "ro.product.cpu.abi"},
+    {"CPU_ABI2", "ro.product.cpu.abi2"},
+    {"DEVICE", "ro.product.device"},
+    {"DEVICE", "ro.product.{}.device"},
+    {"DISPLAY", "ro.build.display.id"},
+    {"FINGERPRINT", "ro.build.fingerprint"},
+    {"FINGERPRINT", "ro.{}.build.fingerprint"},
+    {"HOST", "ro.build.host"},
+    {"ID", "ro.build.id"},
+    {"ID", "ro.{}.build.id"},
+    {"MANUFACTURER", "ro.product.manufacturer"},
+    {"MANUFACTURER", "ro.product.{}.manufacturer"},
+    {"MODEL", "ro.product.model"},
+    {"MODEL", "ro.product.{}.model"},
+    {"ODM_SKU", "ro.boot.product.hardware.sku"},
+    {"PRODUCT", "ro.product.name"},
+    {"PRODUCT", "ro.product.{}.name"},
+    {"SERIAL", "ro.serialno"},
+    {"SERIAL", "ro.boot.serialno"},
+    {"SKU", "ro.boot.hardware.sku"},
+    {"SOC_MANUFACTURER", "ro.soc.manufacturer"},
+    {"SOC_MODEL", "ro.soc.model"},
+    {"TAGS", "ro.build.tags"},
+    {"TAGS", "ro.{}.build.tags"},
+    {"TYPE", "ro.build.type"},
+    {"TYPE", "ro.{}.build.type"},
+    {"USER", "ro.build.user"},
+    {"TIME", "ro.build.date.utc"},
+    {"TIME", "ro.{}.build.date.utc"},
+    {"BASE_OS", "ro.build.version.base_os"},
+    {"CODENAME", "ro.build.version.codename"},
+    {"INCREMENTAL", "ro.build.version.incremental"},
+    {"INCREMENTAL", "ro.{}.build.version.incremental"},
+    {"RELEASE", "ro.build.version.release"},
+    {"RELEASE", "ro.{}.build.version.release"},
+    {"RELEASE_OR_CODENAME", "ro.build.version.release_or_codename"},
+    {"RELEASE_OR_CODENAME", "ro.{}.build.version.release_or_codename"},
+    {"RELEASE_OR_PREVIEW_DISPLAY", "ro.build.version.release_or_preview_display"},
+    {"SECURITY_PATCH", "ro.build.version.security_patch"},
+    {"SECURITY_PATCH", "ro.vendor.build.security_patch"},
+    {"PREVIEW_SDK_INT", "ro.build.version.preview_sdk"},
+    {"MEDIA_PERFORMANCE_CLASS", "ro.odm.build.media_performance_class"},
+};
+
+constexpr const char* signature(FieldType type) {
+    switch (type) {
+        case TYPE_INT:
+            return "I";
+        case TYPE_LONG:
+            return "J";
+        case TYPE_BOOLEAN:
+            return "Z";
+        case TYPE_STRING_ARRAY:
+            return "[Ljava/lang/String;";
+        case TYPE_STRING:
+        default:
+            return "Ljava/lang/String;";
+    }
+}
+
+constexpr size_t DESCRIPTOR_COUNT = std::size(DESCRIPTORS);
+
+// 字段名到 DESCRIPTORS 下标的完美哈希: 编译期搜索一个使所有字段名落入不同槽位的种子,
+// 查询只需一次哈希与一次字符串比较
+constexpr uint32_t PERFECT_HASH_SLOTS = 256;
+constexpr uint8_t EMPTY_SLOT = 0xFF;
+static_assert(DESCRIPTOR_COUNT < EMPTY_SLOT, "too many descriptors for uint8_t slots");
+
+constexpr uint32_t seededHash(std::string_view name, uint32_t seed) {
+    uint32_t hash = 2166136261u ^ seed;
+    for (char c : name) {
+        hash ^= static_cast<uint8_t>(c);
+        hash *= 16777619u;
+    }
+    return hash ^ (hash >> 15);
+}
+
+constexpr uint32_t findPerfectHashSeed() {
+    for (uint32_t seed = 1; seed < 100000; seed++) {
+        bool used[PERFECT_HASH_SLOTS] = {};
+        bool collision = false;
+        for (const Descriptor& descriptor : DESCRIPTORS) {
+            uint32_t slot = seededHash(descriptor.name, seed) % PERFECT_HASH_SLOTS;
+            if (used[slot]) {
+                collision = true;
+                break;
+            }
+            used[slot] = true;
+        }
+        if (!collision) {
+            return seed;
+        }
+    }
+    return 0;
+}
+
+constexpr uint32_t PERFECT_HASH_SEED = findPerfectHashSeed();
+static_assert(PERFECT_HASH_SEED != 0, "no perfect hash seed for BuildFields::DESCRIPTORS");
+
+constexpr std::array<uint8_t, PERFECT_HASH_SLOTS> PERFECT_HASH_TABLE = [] {
+    std::array<uint8_t, PERFECT_HASH_SLOTS> table{};
+    table.fill(EMPTY_SLOT);
+    for (size_t i = 0; i < DESCRIPTOR_COUNT; i++) {
+        table[seededHash(DESCRIPTORS[i].name, PERFECT_HASH_SEED) % PERFECT_HASH_SLOTS] = static_cast<uint8_t>(i);
+    }
+    return table;
+}();
+
+// 返回字段在 DESCRIPTORS 中的下标, 未知字段返回 -1
+constexpr int indexOf(std::string_view name) {
+    uint8_t index = PERFECT_HASH_TABLE[seededHash(name, PERFECT_HASH_SEED) % PERFECT_HASH_SLOTS];
+    return index != EMPTY_SLOT && DESCRIPTORS[index].name == name ? index : -1;
+}
+
+constexpr const Descriptor* find(std::string_view name) {
+    int index = indexOf(name);
+    return index >= 0 ? &DESCRIPTORS[index] : nullptr;
+}
+
+static_assert(indexOf("SDK_INT") >= 0 && DESCRIPTORS[indexOf("SDK_INT")].name == "SDK_INT");
+static_assert(indexOf("NOT_A_FIELD") < 0);
+
+} // namespace BuildFields
+
+#endif // BUILD_FIELDS_HPP
@@ -2,16 +2,871 @@
 #define COMPANION_HPP
 
 #include "utils.hpp"
+#include "build_fields.hpp"
+#include "profile_index.hpp"
+#include "profile_payload.hpp"
+#include "property_area.hpp"
+#include "protocol.hpp"
+#include "snapshot_store.hpp"
+
+#include <dirent.h>
 
 using json = nlohmann::json;
 
+constexpr const char* CONFIG_DIR = "/data/adb/fdi";
+constexpr const char* CONFIG_FILE_NAME = "config.json";
 constexpr const char* CONFIG_FILE = "/data/adb/fdi/config.json";
 constexpr const char* CONFIG_BACKUP_FILE = "/data/adb/fdi/do_not_edit_it";
+constexpr const char* CONFIG_INDEX_FILE = "/data/adb/fdi/config.bin";
+constexpr const char* CONFIG_INDEX_TEMP_FILE = "/data/adb/fdi/config.bin.tmp";
+constexpr const char* MODULE_DIR = "/data/adb/modules/fakedeviceinfo";
+constexpr const char* TARGET_INDEX_FILE_NAME = "targets.bin";
+constexpr const char* TARGET_INDEX_FILE = "/data/adb/modules/fakedeviceinfo/targets.bin";
+constexpr const char* TARGET_INDEX_TEMP_FILE = "/data/adb/modules/fakedeviceinfo/targets.bin.tmp";
+// files 中单个虚拟文件内容的上限
+constexpr size_t MAX_VIRTUAL_FILE_SIZE = 64 * 1024;
 
 namespace Companion {
 
-inline std::unordered_map<std::string, std::shared_ptr<json>> cachedTargetProfileMap;
-inline std::filesystem::file_time_type lastConfigWriteTime;
+// 一次配置加载发布的全部数据, 作为整体替换
+struct ProfileSnapshot {
+    std::unique_ptr<ProfileIndex::MappedFile> index;
+    // 属性区覆盖镜像所在的密封 memfd, 不可用时为 -1
+    int overlayFd = -1;
+    // 按 profile 下标存放覆盖镜像在 overlayFd 中的位置, size 为 0 表示没有
+    std::vector<Protocol::PropertyOverlayLocation> overlays;
+
+    ProfileSnapshot() = default;
+    ProfileSnapshot(const ProfileSnapshot&) = delete;
+    ProfileSnapshot& operator=(const ProfileSnapshot&) = delete;
+
+    ~ProfileSnapshot() {
+        if (overlayFd >= 0) {
+            close(overlayFd);
+        }
+    }
+};
+
+// Companion 进程独有的状态. 本库同时被加载到每个 app 进程, 因此不使用带构造/析构的全局变量,
+// 而是在 Companion 首次处理请求时构造; 进程常驻, 不做析构.
+struct State {
+    // 当前使用的编译索引 (mmap 自 CONFIG_INDEX_FILE) 与属性区覆盖镜像, 每个 profile 的响应帧已预先组好,
+    // 查询时只需一次 write. 重新加载时整体替换, 查询连接无锁读取, 旧快照在最后一个读者离开后释放.
+    SnapshotStore<ProfileSnapshot> profileStore;
+    // 已完整加载的配置文件修改时间; 查询路径无锁比较, 不一致时在后台重新加载
+    std::atomic<int64_t> loadedWriteTime{INT64_MIN};
+    std::mutex configReloadMutex;
+    // 后台加载线程运行中, 同一时刻只有一个
+    std::atomic<bool> reloadRunning{false};
+
+    // inotify 监视线程运行时, 查询路径不再 stat 配置文件
+    std::atomic<bool> configWatcherRunning{false};
+    std::atomic<uint64_t> skippedStatCalls{0};
+    // 在 Protocol::REQUEST_TIMEOUT_MS 内未发完请求的客户端数
+    std::atomic<uint64_t> requestTimeouts{0};
+};
+
+inline State& state() {
+    static State* instance = new State();
+    return *instance;
+}
+
+struct ClassifiedField {
+    const BuildFields::Descriptor* descriptor;
+    std::string value;        // TYPE_STRING_ARRAY 的各元素以 '\0' 连接
+    int64_t intValue;
+    uint16_t elementCount;
+};
+
+// 拆分后的 BCP-47 语言标签, language 为空表示不伪装语言
+struct LocaleParts {
+    std::string tag; // 规范化后的完整标签, 如 "zh-Hans-CN"
+    std::string language;
+    std::string script;
+    std::string region;
+    std::string variant;
+};
+
+// kernel 中给出的 uname 字段, 空串表示保留真实值
+struct KernelParts {
+    std::string sysname;
+    std::string release;
+    std::string version;
+    std::string machine;
+};
+
+// Companion 为每个 profile 预先完成的全部解析与校验结果
+struct ClassifiedProfile {
+    std::vector<ClassifiedField> buildFields;
+    LocaleParts locale;
+    // 属性名 -> 取值, 按名称排序且不重复
+    std::map<std::string, std::string> properties;
+    // "propsMode": "overlay", 优先以属性区覆盖提供 properties
+    bool propertyOverlay = false;
+    // "deriveProps": true 时从 build 字段派生系统属性. 派生会改写本机已有的属性, 默认关闭
+    bool deriveProperties = false;
+    // 虚拟文件的绝对路径 -> 内容
+    std::map<std::string, std::string> files;
+    KernelParts kernel;
+};
+
+inline int deviceSdkInt() {
+    static const int sdkInt = [] {
+        char value[PROP_VALUE_MAX] = {};
+        __system_property_get("ro.build.version.sdk", value);
+        return atoi(value);
+    }();
+    return sdkInt;
+}
+
+template <class T>
+inline bool parseInteger(const std::string& text, T& result) {
+    auto [end, ec] = std::from_chars(text.data(), text.data() + text.size(), result);
+    return ec == std::errc() && end == text.data() + text.size();
+}
+
+// 按字段的 JNI 类型解析配置中的取值. 标量既可写成 JSON 数字/布尔值, 也可写成字符串;
+// 字符串数组既可写成 JSON 数组, 也可写成逗号分隔的字符串
+inline bool parseFieldValue(const BuildFields::Descriptor& descriptor, const json& value, ClassifiedField& field) {
+    switch (descriptor.type) {
+        case BuildFields::TYPE_STRING:
+            if (value.is_string()) {
+                field.value = value.get<std::string>();
+            } else if (value.is_number_integer()) {
+                field.value = value.dump();
+            } else {
+                return false;
+            }
+            return field.value.find('\0') == std::string::npos;
+        case BuildFields::TYPE_INT:
+        case BuildFields::TYPE_LONG: {
+            if (value.is_number_integer()) {
+                field.intValue = value.get<int64_t>();
+            } else if (!value.is_string() || !parseInteger(value.get_ref<const std::string&>(), field.intValue)) {
+                return false;
+            }
+            if (descriptor.type == BuildFields::TYPE_INT &&
+                (field.intValue < INT32_MIN || field.intValue > INT32_MAX)) {
+                return false;
+            }
+            field.value = std::to_string(field.intValue);
+            return true;
+        }
+        case BuildFields::TYPE_BOOLEAN: {
+            if (value.is_boolean()) {
+                field.intValue = value.get<bool>();
+            } else if (value.is_number_integer() && (value == 0 || value == 1)) {
+                field.intValue = value.get<int64_t>();
+            } else if (value.is_string() && (value == "true" || value == "1")) {
+                field.intValue = 1;
+            } else if (value.is_string() && (value == "false" || value == "0")) {
+                field.intValue = 0;
+            } else {
+                return false;
+            }
+            field.value = field.intValue ? "true" : "false";
+            return true;
+        }
+        case BuildFields::TYPE_STRING_ARRAY: {
+            std::vector<std::string> elements;
+            if (value.is_array()) {
+                for (const auto& element : value) {
+                    if (!element.is_string()) {
+                        return false;
+                    }
+                    elements.push_back(element.get<std::string>());
+                }
+            } else if (value.is_string()) {
+                const std::string& text = value.get_ref<const std::string&>();
+                for (size_t begin = 0; !text.empty() && begin <= text.size();) {
+                    size_t end = std::min(text.find(',', begin), text.size());
+                    elements.push_back(text.substr(begin, end - begin));
+                    begin = end + 1;
+                }
+            } else {
+                return false;
+            }
+            if (elements.size() > UINT16_MAX) {
+                return false;
+            }
+            for (size_t i = 0; i < elements.size(); i++) {
+                if (elements[i].find('\0') != std::string::npos) {
+                    return false;
+                }
+                if (i > 0) {
+                    field.value.push_back('\0');
+                }
+                field.value.append(elements[i]);
+            }
+            field.elementCount = static_cast<uint16_t>(elements.size());
+            return true;
+        }
+        default:
+            return false;
+    }
+}
+
+// 解析 language[-script][-region][-variant...] 形式的语言标签 (也接受 '_' 分隔), 并按惯例规范大小写.
+// 不支持扩展子标签与私有子标签, 这类取值返回 false
+inline bool parseLocaleTag(const std::string& text, LocaleParts& locale) {
+    auto isAlpha = [](std::string_view part) {
+        return std::all_of(part.begin(), part.end(), [](char c) { return isalpha(static_cast<uint8_t>(c)); });
+    };
+    auto isDigit = [](std::string_view part) {
+        return std::all_of(part.begin(), part.end(), [](char c) { return isdigit(static_cast<uint8_t>(c)); });
+    };
+    auto isAlnum = [](std::string_view part) {
+        return std::all_of(part.begin(), part.end(), [](char c) { return isalnum(static_cast<uint8_t>(c)); });
+    };
+    auto lower = [](std::string_view part) {
+        std::string result(part);
+        std::transform(result.begin(), result.end(), result.begin(), [](char c) { return tolower(c); });
+        return result;
+    };
+    auto upper = [](std::string_view part) {
+        std::string result(part);
+        std::transform(result.begin(), result.end(), result.begin(), [](char c) { return toupper(c); });
+        return result;
+    };
+
+    std::vector<std::string_view> parts;
+    std::string_view rest(text);
+    while (true) {
+        size_t end = rest.find_first_of("-_");
+        parts.push_back(rest.substr(0, end));
+        if (end == std::string_view::npos) {
+            break;
+        }
+        rest.remove_prefix(end + 1);
+    }
+
+    size_t i = 0;
+    if (parts[i].size() < 2 || parts[i].size() > 8 || parts[i].size() == 4 || !isAlpha(parts[i])) {
+        return false;
+    }
+    LocaleParts result;
+    result.language = lower(parts[i++]);
+    if (i < parts.size() && parts[i].size() == 4 && isAlpha(parts[i])) {
+        result.script = lower(parts[i++]);
+        result.script[0] = static_cast<char>(toupper(result.script[0]));
+    }
+    if (i < parts.size() && ((parts[i].size() == 2 && isAlpha(parts[i])) || (parts[i].size() == 3 && isDigit(parts[i])))) {
+        result.region = upper(parts[i++]);
+    }
+    for (; i < parts.size(); i++) {
+        bool variant = (parts[i].size() >= 5 && parts[i].size() <= 8 && isAlnum(parts[i])) ||
+                       (parts[i].size() == 4 && isdigit(static_cast<uint8_t>(parts[i][0])) && isAlnum(parts[i]));
+        if (!variant) {
+            return false;
+        }
+        if (!result.variant.empty()) {
+            result.variant.push_back('_');
+        }
+        result.variant.append(lower(parts[i]));
+    }
+
+    result.tag = result.language;
+    for (const std::string* part : {&result.script, &result.region}) {
+        if (!part->empty()) {
+            result.tag.append("-").append(*part);
+        }
+    }
+    if (!result.variant.empty()) {
+        std::string variantTag = result.variant;
+        std::replace(variantTag.begin(), variantTag.end(), '_', '-');
+        result.tag.append("-").append(variantTag);
+    }
+    locale = std::move(result);
+    return true;
+}
+
+// 校验 props 中的系统属性覆盖项: 取值需能放入 PROP_VALUE_MAX (native 读取接口的缓冲区大小)
+inline void classifyProperties(const json& props, std::map<std::string, std::string>& properties) {
+    for (const auto& [name, value] : props.items()) {
+        if (name.empty() || name.find('\0') != std::string::npos) {
+            LOGW("无效的属性名，已忽略");
+            continue;
+        }
+        if (!value.is_string() && !value.is_number_integer() && !value.is_boolean()) {
+            LOGW("属性 %s 的取值类型无效，已忽略", name.c_str());
+            continue;
+        }
+        std::string text = value.is_string() ? value.get<std::string>() : value.dump();
+        if (text.size() >= PROP_VALUE_MAX || text.find('\0') != std::string::npos) {
+            LOGW("属性 %s 的取值过长或包含 '\\0'，已忽略", name.c_str());
+            continue;
+        }
+        properties[name] = std::move(text);
+    }
+}
+
+// 校验 files 中的虚拟文件: 路径须为绝对路径, 内容为字符串且不超过 MAX_VIRTUAL_FILE_SIZE
+inline void classifyFiles(const json& files, std::map<std::string, std::string>& classified) {
+    for (const auto& [path, content] : files.items()) {
+        if (path.size() < 2 || path[0] != '/' || path.size() >= PATH_MAX || path.find('\0') != std::string::npos) {
+            LOGW("无效的虚拟文件路径: %s，已忽略", path.c_str());
+            continue;
+        }
+        if (!content.is_string() || content.get_ref<const std::string&>().size() > MAX_VIRTUAL_FILE_SIZE) {
+            LOGW("虚拟文件 %s 的内容不是字符串或超过 %zu 字节，已忽略", path.c_str(), MAX_VIRTUAL_FILE_SIZE);
+            continue;
+        }
+        classified[path] = content.get<std::string>();
+    }
+}
+
+// 校验 kernel 中的 uname 字段: 只接受 sysname/release/version/machine, 取值需能放入 utsname 的字段
+inline void classifyKernel(const json& kernel, KernelParts& classified) {
+    std::pair<const char*, std::string*> fields[] = {{"sysname", &classified.sysname},
+                                                     {"release", &classified.release},
+                                                     {"version", &classified.version},
+                                                     {"machine", &classified.machine}};
+    for (const auto& [key, value] : kernel.items()) {
+        auto field = std::find_if(std::begin(fields), std::end(fields),
+                                  [&key](const auto& candidate) { return key == candidate.first; });
+        if (field == std::end(fields)) {
+            LOGW("未知的 kernel 字段: %s，已忽略", key.c_str());
+            continue;
+        }
+        if (!value.is_string() || value.get_ref<const std::string&>().size() >= sizeof(utsname::release) ||
+            value.get_ref<const std::string&>().find('\0') != std::string::npos) {
+            LOGW("kernel 字段 %s 的取值无效: %s，已忽略", key.c_str(), value.dump().c_str());
+            continue;
+        }
+        *field->second = value.get<std::string>();
+    }
+}
+
+// 为 build 中的每个键确定所属类与 JNI 类型并预先解析取值; 未知字段, 本机系统不存在的字段
+// 以及取值无效的字段在加载时直接丢弃, 不再留给每个 app 进程去试探
+inline std::vector<ClassifiedField> classifyBuildFields(const json& build) {
+    std::vector<ClassifiedField> classified;
+    for (const auto& [key, value] : build.items()) {
+        const BuildFields::Descriptor* descriptor = BuildFields::find(key);
+        if (!descriptor) {
+            LOGW("未知的 Build 字段: %s，已忽略", key.c_str());
+            continue;
+        }
+        if (descriptor->minSdk > deviceSdkInt()) {
+            LOGW("字段 %s 需要 API %d，当前系统为 %d，已忽略", key.c_str(), descriptor->minSdk, deviceSdkInt());
+            continue;
+        }
+        ClassifiedField field{descriptor, {}, 0, 0};
+        if (!parseFieldValue(*descriptor, value, field)) {
+            LOGW("字段 %s 的取值与类型 %s 不符: %s，已忽略", key.c_str(), BuildFields::signature(descriptor->type),
+                 value.dump().c_str());
+            continue;
+        }
+        classified.push_back(std::move(field));
+    }
+    return classified;
+}
+
+// 字段取值在系统属性中的写法
+inline std::string propertyValue(const ClassifiedField& field) {
+    switch (field.descriptor->type) {
+        case BuildFields::TYPE_INT:
+            return std::to_string(field.intValue);
+        case BuildFields::TYPE_LONG:
+            // 目前只有 TIME: 字段以毫秒计, ro.build.date.utc 以秒计
+            return std::to_string(field.intValue / 1000);
+        case BuildFields::TYPE_BOOLEAN:
+            return field.intValue ? "1" : "0";
+        case BuildFields::TYPE_STRING_ARRAY: {
+            std::string joined = field.value;
+            std::replace(joined.begin(), joined.end(), '\0', ',');
+            return joined;
+        }
+        case BuildFields::TYPE_STRING:
+        default:
+            return field.value;
+    }
+}
+
+// 由 build 字段派生出本机存在的全部对应系统属性 (含各分区变体), 仅在 profile 指定 "deriveProps": true
+// 时于加载配置时完成一次, app 进程不再拼接属性名. props 中显式给出的属性优先
+inline void deriveProperties(const std::vector<ClassifiedField>& buildFields,
+                             std::map<std::string, std::string>& properties) {
+    auto derive = [&properties](std::string name, const std::string& value) {
+        if (properties.count(name) == 0 && __system_property_find(name.c_str())) {
+            properties.emplace(std::move(name), value);
+        }
+    };
+    for (const ClassifiedField& field : buildFields) {
+        std::string value = propertyValue(field);
+        if (value.size() >= PROP_VALUE_MAX) {
+            LOGW("字段 %.*s 的取值过长，不派生系统属性", static_cast<int>(field.descriptor->name.size()),
+                 field.descriptor->name.data());
+            continue;
+        }
+        for (const BuildFields::PropertyDerivation& derivation : BuildFields::PROPERTY_DERIVATIONS) {
+            if (derivation.field != field.descriptor->name) {
+                continue;
+            }
+            size_t placeholder = derivation.pattern.find("{}");
+            if (placeholder == std::string_view::npos) {
+                derive(std::string(derivation.pattern), value);
+                continue;
+            }
+            for (std::string_view partition : BuildFields::PARTITIONS) {
+                std::string name(derivation.pattern.substr(0, placeholder));
+                name.append(partition).append(derivation.pattern.substr(placeholder + 2));
+                derive(std::move(name), value);
+            }
+        }
+    }
+}
+
+// 将 config.json 编译为 ProfileIndex 格式
+class IndexBuilder {
+public:
+    explicit IndexBuilder(bool targetsOnly = false) : targetsOnly(targetsOnly) {}
+
+    void addProfile(const json& profile, const ClassifiedProfile& classified) {
+        using namespace ProfileIndex;
+
+        auto profileIndex = static_cast<uint32_t>(profiles.size());
+        ProfileRecord record{};
+        record.name = addString(profile.contains("name") && profile["name"].is_string()
+                                ? profile["name"].get<std::string>() : std::string());
+        if (targetsOnly) {
+            profiles.push_back(record);
+            addTargets(profile, profileIndex);
+            return;
+        }
+
+        record.firstField = static_cast<uint32_t>(fields.size());
+        for (const ClassifiedField& field : classified.buildFields) {
+            const BuildFields::Descriptor& descriptor = *field.descriptor;
+            fields.push_back({addString(std::string(descriptor.name)), addString(field.value),
+                              descriptor.fieldClass, descriptor.type, field.elementCount, 0, field.intValue});
+        }
+        record.fieldCount = static_cast<uint32_t>(fields.size()) - record.firstField;
+
+        std::vector<uint8_t> payload = encodePayload(profile, classified);
+        const Protocol::ResponseHeader response =
+            Protocol::makeResponseHeader(Protocol::STATUS_MATCHED, static_cast<uint32_t>(payload.size()));
+        record.responseOffset = static_cast<uint32_t>(responses.size());
+        record.responseSize = static_cast<uint32_t>(sizeof(response) + payload.size());
+        responses.insert(responses.end(), reinterpret_cast<const uint8_t*>(&response),
+                         reinterpret_cast<const uint8_t*>(&response) + sizeof(response));
+        responses.insert(responses.end(), payload.begin(), payload.end());
+        profiles.push_back(record);
+        addTargets(profile, profileIndex);
+    }
+
+    size_t targetCount() const { return targets.size() + patternCount; }
+
+    std::vector<uint8_t> finish(int64_t sourceWriteTime) const {
+        using namespace ProfileIndex;
+
+        // 节点总是在父节点之后创建, 按创建顺序展开即可
+        std::vector<TrieNode> trieNodes;
+        std::vector<TrieEdge> trieEdges;
+        for (const auto& node : patternNodes) {
+            trieNodes.push_back({static_cast<uint32_t>(trieEdges.size()),
+                                 static_cast<uint32_t>(node.children.size()), node.profile});
+            for (const auto& [ch, childIndex] : node.children) {
+                trieEdges.push_back({ch, {}, childIndex});
+            }
+        }
+
+        uint32_t bucketCount = 1;
+        while (bucketCount < targets.size() * 2) {
+            bucketCount <<= 1;
+        }
+        std::vector<uint32_t> buckets(bucketCount, 0);
+        for (uint32_t i = 0; i < targets.size(); i++) {
+            uint32_t slot = targets[i].hash & (bucketCount - 1);
+            while (buckets[slot] != 0) {
+                slot = (slot + 1) & (bucketCount - 1);
+            }
+            buckets[slot] = i + 1;
+        }
+
+        Header header{};
+        header.magic = INDEX_MAGIC;
+        header.version = INDEX_VERSION;
+        header.headerSize = sizeof(Header);
+        if (targetsOnly) {
+            header.flags |= INDEX_FLAG_TARGETS_ONLY;
+        }
+        header.sourceWriteTime = sourceWriteTime;
+
+        uint32_t offset = sizeof(Header);
+        auto place = [&offset](uint32_t& sectionOffset, size_t bytes) {
+            offset = (offset + 7u) & ~7u;
+            sectionOffset = offset;
+            offset += static_cast<uint32_t>(bytes);
+        };
+        place(header.stringPoolOffset, stringPool.size());
+        place(header.targetOffset, targets.size() * sizeof(TargetEntry));
+        place(header.bucketOffset, buckets.size() * sizeof(uint32_t));
+        place(header.nodeOffset, trieNodes.size() * sizeof(TrieNode));
+        place(header.edgeOffset, trieEdges.size() * sizeof(TrieEdge));
+        place(header.profileOffset, profiles.size() * sizeof(ProfileRecord));
+        place(header.fieldOffset, fields.size() * sizeof(FieldRecord));
+        place(header.responseOffset, responses.size());
+        header.stringPoolSize = static_cast<uint32_t>(stringPool.size());
+        header.targetCount = static_cast<uint32_t>(targets.size());
+        header.bucketCount = bucketCount;
+        header.profileCount = static_cast<uint32_t>(profiles.size());
+        header.fieldCount = static_cast<uint32_t>(fields.size());
+        header.responseSize = static_cast<uint32_t>(responses.size());
+        header.nodeCount = static_cast<uint32_t>(trieNodes.size());
+        header.edgeCount = static_cast<uint32_t>(trieEdges.size());
+        header.fileSize = offset;
+
+        std::vector<uint8_t> image(offset, 0);
+        memcpy(image.data(), &header, sizeof(header));
+        memcpy(image.data() + header.stringPoolOffset, stringPool.data(), stringPool.size());
+        memcpy(image.data() + header.targetOffset, targets.data(), targets.size() * sizeof(TargetEntry));
+        memcpy(image.data() + header.bucketOffset, buckets.data(), buckets.size() * sizeof(uint32_t));
+        memcpy(image.data() + header.nodeOffset, trieNodes.data(), trieNodes.size() * sizeof(TrieNode));
+        memcpy(image.data() + header.edgeOffset, trieEdges.data(), trieEdges.size() * sizeof(TrieEdge));
+        memcpy(image.data() + header.profileOffset, profiles.data(), profiles.size() * sizeof(ProfileRecord));
+        memcpy(image.data() + header.fieldOffset, fields.data(), fields.size() * sizeof(FieldRecord));
+        memcpy(image.data() + header.responseOffset, responses.data(), responses.size());
+        return image;
+    }
+
+private:
+    struct PatternNode {
+        std::map<uint8_t, uint32_t> children;
+        uint32_t profile = 0;
+    };
+
+    bool targetsOnly;
+    std::string stringPool;
+    std::unordered_map<std::string, uint32_t> stringOffsets;
+    std::vector<ProfileIndex::TargetEntry> targets;
+    std::unordered_map<std::string, uint32_t> targetIndices;
+    std::vector<ProfileIndex::ProfileRecord> profiles;
+    std::vector<ProfileIndex::FieldRecord> fields;
+    std::vector<uint8_t> responses;
+    // 前缀 trie 与后缀 trie 共用节点数组, 根节点分别为 0 和 1
+    std::vector<PatternNode> patternNodes = std::vector<PatternNode>(2);
+    size_t patternCount = 0;
+
+    void addTargets(const json& profile, uint32_t profileIndex) {
+        for (const auto& target : profile["targets"]) {
+            if (!target.is_string()) {
+                LOGW("跳过非字符串 target");
+                continue;
+            }
+            addTarget(target.get<std::string>(), profileIndex);
+        }
+    }
+
+    void addTarget(const std::string& targetName, uint32_t profileIndex) {
+        size_t wildcards = std::count(targetName.begin(), targetName.end(), '*');
+        if (wildcards == 0) {
+            // 同名 target 以后出现的 profile 为准
+            auto [it, inserted] = targetIndices.try_emplace(targetName, static_cast<uint32_t>(targets.size()));
+            if (inserted) {
+                targets.push_back({ProfileIndex::hashName(targetName), profileIndex, addString(targetName)});
+            } else {
+                targets[it->second].profileIndex = profileIndex;
+            }
+            LOGD("添加映射: %s -> profile", targetName.c_str());
+            return;
+        }
+
+        bool isPrefix = targetName.back() == '*';
+        if (wildcards != 1 || (!isPrefix && targetName.front() != '*')) {
+            LOGW("不支持的 target 模式: %s (仅支持 'prefix*' 与 '*suffix')", targetName.c_str());
+            return;
+        }
+
+        uint32_t node = isPrefix ? ProfileIndex::PREFIX_TRIE_ROOT : ProfileIndex::SUFFIX_TRIE_ROOT;
+        std::string literal = isPrefix ? targetName.substr(0, targetName.size() - 1) : targetName.substr(1);
+        if (!isPrefix) {
+            std::reverse(literal.begin(), literal.end());
+        }
+        for (char c : literal) {
+            auto ch = static_cast<uint8_t>(c);
+            auto it = patternNodes[node].children.find(ch);
+            if (it == patternNodes[node].children.end()) {
+                auto next = static_cast<uint32_t>(patternNodes.size());
+                patternNodes[node].children.emplace(ch, next);
+                patternNodes.emplace_back();
+                node = next;
+            } else {
+                node = it->second;
+            }
+        }
+        patternNodes[node].profile = profileIndex + 1;
+        patternCount++;
+        LOGD("添加%s模式: %s -> profile", isPrefix ? "前缀" : "后缀", targetName.c_str());
+    }
+
+    ProfileIndex::StringRef addString(const std::string& str) {
+        auto [it, inserted] = stringOffsets.try_emplace(str, static_cast<uint32_t>(stringPool.size()));
+        if (inserted) {
+            stringPool.append(str);
+            stringPool.push_back('\0');
+        }
+        return {it->second, static_cast<uint32_t>(str.size())};
+    }
+
+    // 组装发给 app 进程的 ProfilePayload 记录, 长度补齐到 8 字节以保持下一条响应对齐
+    static std::vector<uint8_t> encodePayload(const json& profile, const ClassifiedProfile& classified) {
+        using namespace ProfilePayload;
+
+        const std::vector<ClassifiedField>& buildFields = classified.buildFields;
+        std::string strings;
+        auto addPayloadString = [&strings](std::string_view str) {
+            PayloadString ref{static_cast<uint32_t>(strings.size()), static_cast<uint32_t>(str.size())};
+            strings.append(str);
+            strings.push_back('\0');
+            return ref;
+        };
+        PayloadHeader header{PAYLOAD_MAGIC, PAYLOAD_VERSION, static_cast<uint16_t>(buildFields.size()), 0, 0, {}, {}, {}, {}, {}};
+        if (classified.propertyOverlay && !classified.properties.empty()) {
+            header.flags |= PAYLOAD_FLAG_PROPERTY_OVERLAY;
+        }
+        uint32_t fieldsEnd = static_cast<uint32_t>(sizeof(PayloadHeader) + buildFields.size() * sizeof(PayloadField));
+        std::vector<uint8_t> propertyArea = encodeProperties(classified.properties, fieldsEnd, header.properties);
+        uint32_t fileAreaOffset = fieldsEnd + static_cast<uint32_t>(propertyArea.size());
+        std::vector<uint8_t> fileArea = encodeFiles(classified.files, fileAreaOffset, header.files);
+        uint32_t stringBase = fileAreaOffset + static_cast<uint32_t>(fileArea.size());
+        // 文件条目按 files 的顺序预留, 字符串区位置确定后再填入
+        uint8_t* fileEntry = fileArea.data() + (header.files.entryOffset - fileAreaOffset);
+        for (const auto& [path, content] : classified.files) {
+            FileEntry entry{addPayloadString(path), addPayloadString(content)};
+            entry.path.offset += stringBase;
+            entry.content.offset += stringBase;
+            memcpy(fileEntry, &entry, sizeof(entry));
+            fileEntry += sizeof(entry);
+        }
+        header.name = addPayloadString(profile.contains("name") && profile["name"].is_string()
+                                       ? profile["name"].get_ref<const std::string&>() : std::string_view());
+        header.name.offset += stringBase;
+        PayloadString* localeStrings[] = {&header.locale.tag, &header.locale.language, &header.locale.script,
+                                          &header.locale.region, &header.locale.variant};
+        const std::string* localeValues[] = {&classified.locale.tag, &classified.locale.language,
+                                             &classified.locale.script, &classified.locale.region,
+                                             &classified.locale.variant};
+        for (size_t i = 0; i < std::size(localeStrings); i++) {
+            *localeStrings[i] = addPayloadString(*localeValues[i]);
+            localeStrings[i]->offset += stringBase;
+        }
+        PayloadString* kernelStrings[] = {&header.kernel.sysname, &header.kernel.release, &header.kernel.version,
+                                          &header.kernel.machine};
+        const std::string* kernelValues[] = {&classified.kernel.sysname, &classified.kernel.release,
+                                             &classified.kernel.version, &classified.kernel.machine};
+        for (size_t i = 0; i < std::size(kernelStrings); i++) {
+            *kernelStrings[i] = addPayloadString(*kernelValues[i]);
+            kernelStrings[i]->offset += stringBase;
+        }
+
+        std::vector<PayloadField> records;
+        records.reserve(buildFields.size());
+        for (const ClassifiedField& field : buildFields) {
+            const BuildFields::Descriptor& descriptor = *field.descriptor;
+            PayloadField record{descriptor.fieldClass, descriptor.type, field.elementCount, 0, field.intValue,
+                                addPayloadString(descriptor.name), addPayloadString(field.value)};
+            record.name.offset += stringBase;
+            record.value.offset += stringBase;
+            records.push_back(record);
+        }
+
+        std::vector<uint8_t> payload((stringBase + strings.size() + 7u) & ~size_t(7), 0);
+        memcpy(payload.data(), &header, sizeof(header));
+        memcpy(payload.data() + sizeof(header), records.data(), records.size() * sizeof(PayloadField));
+        memcpy(payload.data() + fieldsEnd, propertyArea.data(), propertyArea.size());
+        memcpy(payload.data() + fileAreaOffset, fileArea.data(), fileArea.size());
+        memcpy(payload.data() + stringBase, strings.data(), strings.size());
+        return payload;
+    }
+
+    // 生成属性哈希桶与 prop_info 兼容的条目, 起始于记录中的 areaOffset (8 字节对齐), 返回长度按 8 字节补齐
+    static std::vector<uint8_t> encodeProperties(const std::map<std::string, std::string>& properties,
+                                                 uint32_t areaOffset, ProfilePayload::PayloadPropertyTable& table) {
+        using namespace ProfilePayload;
+
+        table = {};
+        if (properties.empty()) {
+            return {};
+        }
+        uint32_t bucketCount = 2;
+        while (bucketCount < properties.size() * 2) {
+            bucketCount <<= 1;
+        }
+        table.bucketCount = bucketCount;
+        table.bucketOffset = areaOffset;
+        table.entryOffset = areaOffset + bucketCount * static_cast<uint32_t>(sizeof(PropertyBucket));
+        table.count = static_cast<uint32_t>(properties.size());
+
+        std::vector<PropertyBucket> buckets(bucketCount, PropertyBucket{0, 0});
+        std::vector<uint8_t> entries;
+        for (const auto& [name, value] : properties) {
+            uint32_t entryOffset = table.entryOffset + static_cast<uint32_t>(entries.size());
+            PropertyEntry entry{};
+            entry.serial = static_cast<uint32_t>(value.size()) << 24;
+            memcpy(entry.value, value.c_str(), value.size() + 1);
+            entries.insert(entries.end(), reinterpret_cast<const uint8_t*>(&entry),
+                           reinterpret_cast<const uint8_t*>(&entry) + sizeof(entry));
+            entries.insert(entries.end(), name.c_str(), name.c_str() + name.size() + 1);
+            entries.resize((entries.size() + alignof(PropertyEntry) - 1) & ~(alignof(PropertyEntry) - 1), 0);
+
+            uint32_t hash = hashKey(name.c_str());
+            uint32_t slot = hash & (bucketCount - 1);
+            while (buckets[slot].entry != 0) {
+                slot = (slot + 1) & (bucketCount - 1);
+            }
+            buckets[slot] = {hash, entryOffset};
+        }
+        table.entrySize = static_cast<uint32_t>(entries.size());
+
+        std::vector<uint8_t> area(bucketCount * sizeof(PropertyBucket));
+        memcpy(area.data(), buckets.data(), area.size());
+        area.insert(area.end(), entries.begin(), entries.end());
+        area.resize((area.size() + 7u) & ~size_t(7), 0);
+        return area;
+    }
+
+    // 生成文件哈希桶, 并按 files 的顺序为条目预留位置 (内容由调用方填入); 起始于 areaOffset (8 字节对齐)
+    static std::vector<uint8_t> encodeFiles(const std::map<std::string, std::string>& files, uint32_t areaOffset,
+                                            ProfilePayload::PayloadFileTable& table) {
+        using namespace ProfilePayload;
+
+        table = {};
+        if (files.empty()) {
+            return {};
+        }
+        uint32_t bucketCount = 2;
+        while (bucketCount < files.size() * 2) {
+            bucketCount <<= 1;
+        }
+        table.bucketCount = bucketCount;
+        table.bucketOffset = areaOffset;
+        table.entryOffset = areaOffset + bucketCount * static_cast<uint32_t>(sizeof(PropertyBucket));
+        table.count = static_cast<uint32_t>(files.size());
+
+        std::vector<PropertyBucket> buckets(bucketCount, PropertyBucket{0, 0});
+        uint32_t entryOffset = table.entryOffset;
+        for (const auto& file : files) {
+            uint32_t hash = hashKey(file.first.c_str());
+            uint32_t slot = hash & (bucketCount - 1);
+            while (buckets[slot].entry != 0) {
+                slot = (slot + 1) & (bucketCount - 1);
+            }
+            buckets[slot] = {hash, entryOffset};
+            entryOffset += sizeof(FileEntry);
+        }
+
+        std::vector<uint8_t> area(bucketCount * sizeof(PropertyBucket) + files.size() * sizeof(FileEntry), 0);
+        memcpy(area.data(), buckets.data(), bucketCount * sizeof(PropertyBucket));
+        area.resize((area.size() + 7u) & ~size_t(7), 0);
+        return area;
+    }
+};
+
+inline bool writeIndexFile(const char* path, const char* tempPath, const std::vector<uint8_t>& image) {
+    int fd = open(tempPath, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        LOGE("无法创建索引文件 %s: %s", tempPath, strerror(errno));
+        return false;
+    }
+    bool ok = safeWrite(fd, image.data(), image.size()) && fsync(fd) == 0;
+    close(fd);
+    // rename 保证已映射旧索引的连接不受影响
+    if (!ok || rename(tempPath, path) != 0) {
+        LOGE("写入索引文件失败 %s: %s", path, strerror(errno));
+        unlink(tempPath);
+        return false;
+    }
+    return true;
+}
+
+// 模块目录中的 target 索引由 app 进程 (zygote 权限) 读取, 沿用目录本身的 SELinux 标签
+inline void copyModuleDirLabel(const char* path) {
+    char context[256];
+    ssize_t len = getxattr(MODULE_DIR, "security.selinux", context, sizeof(context));
+    if (len <= 0 || setxattr(path, "security.selinux", context, len, 0) != 0) {
+        LOGW("无法设置 %s 的 SELinux 标签: %s", path, strerror(errno));
+    }
+}
+
+// 由完整索引生成 target 索引: 哈希桶与 trie 原样复制, 字符串池只保留 target 与 profile 名称,
+// 不含 build 字段与响应数据. 用于完整索引仍然有效而 target 索引缺失 (例如开机后) 的情况
+inline std::vector<uint8_t> extractTargetIndex(const ProfileIndex::MappedFile& index) {
+    using namespace ProfileIndex;
+
+    const uint8_t* base = index.bytes();
+    const Header& source = index.view().header();
+    std::string stringPool;
+    auto copyString = [&](StringRef ref) {
+        StringRef copied{static_cast<uint32_t>(stringPool.size()), ref.length};
+        stringPool.append(index.view().string(ref));
+        stringPool.push_back('\0');
+        return copied;
+    };
+    std::vector<TargetEntry> targets(source.targetCount);
+    memcpy(targets.data(), base + source.targetOffset, targets.size() * sizeof(TargetEntry));
+    for (TargetEntry& target : targets) {
+        target.name = copyString(target.name);
+    }
+    std::vector<ProfileRecord> profiles(source.profileCount);
+    for (uint32_t i = 0; i < source.profileCount; i++) {
+        profiles[i].name = copyString(index.view().profile(i).name);
+    }
+
+    Header header{};
+    header.magic = INDEX_MAGIC;
+    header.version = INDEX_VERSION;
+    header.headerSize = sizeof(Header);
+    header.flags = source.flags | INDEX_FLAG_TARGETS_ONLY;
+    header.sourceWriteTime = source.sourceWriteTime;
+    uint32_t offset = sizeof(Header);
+    auto place = [&offset](uint32_t& sectionOffset, size_t bytes) {
+        offset = (offset + 7u) & ~7u;
+        sectionOffset = offset;
+        offset += static_cast<uint32_t>(bytes);
+    };
+    place(header.stringPoolOffset, stringPool.size());
+    place(header.targetOffset, targets.size() * sizeof(TargetEntry));
+    place(header.bucketOffset, source.bucketCount * sizeof(uint32_t));
+    place(header.nodeOffset, source.nodeCount * sizeof(TrieNode));
+    place(header.edgeOffset, source.edgeCount * sizeof(TrieEdge));
+    place(header.profileOffset, profiles.size() * sizeof(ProfileRecord));
+    place(header.fieldOffset, 0);
+    place(header.responseOffset, 0);
+    header.stringPoolSize = static_cast<uint32_t>(stringPool.size());
+    header.targetCount = source.targetCount;
+    header.bucketCount = source.bucketCount;
+    header.nodeCount = source.nodeCount;
+    header.edgeCount = source.edgeCount;
+    header.profileCount = source.profileCount;
+    header.fileSize = offset;
+
+    std::vector<uint8_t> image(offset, 0);
+    memcpy(image.data(), &header, sizeof(header));
+    memcpy(image.data() + header.stringPoolOffset, stringPool.data(), stringPool.size());
+    memcpy(image.data() + header.targetOffset, targets.data(), targets.size() * sizeof(TargetEntry));
+    memcpy(image.data() + header.bucketOffset, base + source.bucketOffset, source.bucketCount * sizeof(uint32_t));
+    memcpy(image.data() + header.nodeOffset, base + source.nodeOffset, source.nodeCount * sizeof(TrieNode));
+    memcpy(image.data() + header.edgeOffset, base + source.edgeOffset, source.edgeCount * sizeof(TrieEdge));
+    memcpy(image.data() + header.profileOffset, profiles.data(), profiles.size() * sizeof(ProfileRecord));
+    return image;
+}
+
+inline bool publishTargetIndex(const std::vector<uint8_t>& image) {
+    if (!writeIndexFile(TARGET_INDEX_FILE, TARGET_INDEX_TEMP_FILE, image)) {
+        return false;
+    }
+    copyModuleDirLabel(TARGET_INDEX_FILE);
+    LOGD("已发布 target 索引: %s (%zu 字节)", TARGET_INDEX_FILE, image.size());
+    return true;
+}
+
+// target 索引不再由监视线程维护时必须移除, 否则 app 进程会按过期索引跳过 Companion
+inline void withdrawTargetIndex() {
+    if (unlink(TARGET_INDEX_FILE) != 0 && errno != ENOENT) {
+        LOGE("无法移除 target 索引: %s", strerror(errno));
+    }
+}
 
 inline void backupConfigFile() {
     LOGD("开始备份配置文件...");
@@ -60,7 +915,123 @@ inline bool loadConfigFromFile(const char* filePath, json& configJson) {
     return true;
 }
 
+// 将索引复制进密封 memfd, 匹配时把 fd 随响应交给 app 进程直接映射, 配置数据不再经过 socket.
+// memfd 不可用 (旧内核) 时继续使用文件映射, 以内联方式发送配置记录.
+inline std::unique_ptr<ProfileIndex::MappedFile> shareIndex(std::unique_ptr<ProfileIndex::MappedFile> fileIndex) {
+    int memfd = createMemfd("fdi_profiles", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (memfd < 0) {
+        LOGW("memfd_create 失败: %s，使用内联响应", strerror(errno));
+        return fileIndex;
+    }
+    if (!safeWrite(memfd, fileIndex->bytes(), fileIndex->byteSize()) ||
+        fcntl(memfd, F_ADD_SEALS, FULL_MEMFD_SEALS) != 0) {
+        LOGW("无法写入或密封 memfd: %s，使用内联响应", strerror(errno));
+        close(memfd);
+        return fileIndex;
+    }
+
+    auto sharedIndex = std::make_unique<ProfileIndex::MappedFile>();
+    if (!sharedIndex->adoptFd(memfd)) {
+        LOGW("无法映射 memfd，使用内联响应");
+        return fileIndex;
+    }
+    return sharedIndex;
+}
+
+// 读取一个属性区文件的完整内容; 属性区大小固定 (bionic 为 128 KiB), 超过 1 MiB 视为异常
+inline bool readPropertyArea(int dirFd, const char* name, std::vector<uint8_t>& content) {
+    int fd = openat(dirFd, name, O_RDONLY | O_CLOEXEC | O_NOFOLLOW);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st{};
+    bool ok = fstat(fd, &st) == 0 && S_ISREG(st.st_mode) &&
+              st.st_size > static_cast<off_t>(sizeof(PropertyArea::AreaHeader)) && st.st_size <= (1 << 20);
+    if (ok) {
+        content.resize(st.st_size);
+        ok = safeRead(fd, content.data(), content.size());
+    }
+    close(fd);
+    return ok;
+}
+
+// 为使用 "propsMode": "overlay" 的 profile 生成属性区覆盖镜像, 依次写入一个密封 memfd.
+// 属性区逐个读取并交给所有 profile 的 builder, 不同时保留全部属性区的内容
+inline void buildPropertyOverlays(ProfileSnapshot& snapshot) {
+    const ProfileIndex::View& index = snapshot.index->view();
+    auto pageSize = static_cast<uint32_t>(sysconf(_SC_PAGESIZE));
+    std::vector<std::pair<uint32_t, PropertyArea::OverlayBuilder>> builders;
+    for (uint32_t i = 0; i < index.profileCount(); i++) {
+        const ProfileIndex::ProfileRecord& profile = index.profile(i);
+        ProfilePayload::View payload;
+        if (payload.attach(index.response(profile) + sizeof(Protocol::ResponseHeader),
+                           profile.responseSize - sizeof(Protocol::ResponseHeader)) &&
+            payload.usesPropertyOverlay()) {
+            builders.emplace_back(i, PropertyArea::OverlayBuilder(payload, pageSize));
+        }
+    }
+    if (builders.empty()) {
+        return;
+    }
+
+    int dirFd = open(PropertyArea::PROPERTIES_DIR, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    DIR* dir = dirFd >= 0 ? fdopendir(dirFd) : nullptr;
+    if (!dir) {
+        LOGE("无法打开 %s: %s", PropertyArea::PROPERTIES_DIR, strerror(errno));
+        if (dirFd >= 0) {
+            close(dirFd);
+        }
+        return;
+    }
+    std::vector<uint8_t> content;
+    size_t areaCount = 0;
+    while (struct dirent* entry = readdir(dir)) {
+        if (entry->d_name[0] == '.' || !readPropertyArea(dirFd, entry->d_name, content)) {
+            continue;
+        }
+        areaCount++;
+        for (auto& [profileIndex, builder] : builders) {
+            builder.addArea(entry->d_name, content.data(), content.size());
+        }
+    }
+    closedir(dir);
+
+    int memfd = createMemfd("fdi_property_overlay", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (memfd < 0) {
+        LOGW("memfd_create 失败: %s，不提供属性区覆盖", strerror(errno));
+        return;
+    }
+    std::vector<Protocol::PropertyOverlayLocation> overlays(index.profileCount(), {0, 0});
+    uint32_t offset = 0;
+    bool ok = true;
+    for (const auto& [profileIndex, builder] : builders) {
+        std::vector<uint8_t> image = builder.finish();
+        if (image.empty()) {
+            continue;
+        }
+        if (!safeWrite(memfd, image.data(), image.size())) {
+            ok = false;
+            break;
+        }
+        overlays[profileIndex] = {offset, static_cast<uint32_t>(image.size())};
+        offset += static_cast<uint32_t>(image.size());
+        LOGD("profile %u 的属性区覆盖镜像: %u 个属性, %zu 字节", profileIndex, builder.coveredCount(), image.size());
+    }
+    if (!ok || offset == 0 || fcntl(memfd, F_ADD_SEALS, FULL_MEMFD_SEALS) != 0) {
+        if (!ok) {
+            LOGW("无法写入属性区覆盖镜像: %s", strerror(errno));
+        }
+        close(memfd);
+        return;
+    }
+    snapshot.overlayFd = memfd;
+    snapshot.overlays = std::move(overlays);
+    LOGD("已读取 %zu 个属性区, 生成覆盖镜像 %u 字节", areaCount, offset);
+}
+
 inline void updateTargetProfileMapCache() {
+    State& companion = state();
+    std::lock_guard reloadLock(companion.configReloadMutex);
     LOGD("检查配置文件是否有更新...");
     std::error_code ec;
     auto currentWriteTime = std::filesystem::last_write_time(CONFIG_FILE, ec);
@@ -69,109 +1040,369 @@ inline void updateTargetProfileMapCache() {
         return;
     }
 
-    if (currentWriteTime == lastConfigWriteTime) {
+    int64_t sourceWriteTime = currentWriteTime.time_since_epoch().count();
+    if (sourceWriteTime == companion.loadedWriteTime.load(std::memory_order_acquire)) {
         LOGD("配置文件未变更，使用缓存数据");
         return;
     }
 
-    LOGD("检测到配置文件更新，开始重新加载...");
-    json configJson;
-    bool usingBackup = false;
+    auto mappedIndex = std::make_unique<ProfileIndex::MappedFile>();
+    bool watching = companion.configWatcherRunning.load(std::memory_order_acquire);
+    if (mappedIndex->map(CONFIG_INDEX_FILE) &&
+        mappedIndex->view().header().sourceWriteTime == sourceWriteTime) {
+        LOGD("编译索引与配置文件一致，直接映射: %s", CONFIG_INDEX_FILE);
+        // post-fs-data.sh 在开机时清除 target 索引; 完整索引仍然有效, 只需从中重新生成, 不必重新编译
+        ProfileIndex::MappedFile publishedTargets;
+        if (watching && !(publishedTargets.map(TARGET_INDEX_FILE) &&
+                          publishedTargets.view().header().sourceWriteTime == sourceWriteTime) &&
+            !publishTargetIndex(extractTargetIndex(*mappedIndex))) {
+            withdrawTargetIndex();
+        }
+    } else {
+        LOGD("检测到配置文件更新，开始重新编译...");
+        json configJson;
+        bool usingBackup = false;
+
+        if (!loadConfigFromFile(CONFIG_FILE, configJson)) {
+            LOGW("主配置文件加载失败，尝试加载备份文件...");
+            if (!loadConfigFromFile(CONFIG_BACKUP_FILE, configJson)) {
+                LOGE("备份配置文件也无法加载，放弃更新缓存");
+                return;
+            }
+            LOGW("从备份文件加载配置");
+            usingBackup = true;
+        }
+
+        IndexBuilder builder;
+        IndexBuilder targetBuilder(true);
+        size_t validProfileCount = 0;
+
+        for (const auto& profile : configJson) {
+            if (!profile.contains("targets") ||
+                !profile["targets"].is_array() ||
+                profile["targets"].empty() ||
+                (profile.contains("build") && !profile["build"].is_object())) {
+                LOGW("跳过无效的配置项：targets 或 build 字段不合法");
+                continue;
+            }
+
+            ClassifiedProfile classified;
+            if (profile.contains("build")) {
+                classified.buildFields = classifyBuildFields(profile["build"]);
+            }
+            if (profile.contains("locale")) {
+                if (!profile["locale"].is_string() ||
+                    !parseLocaleTag(profile["locale"].get_ref<const std::string&>(), classified.locale)) {
+                    LOGW("locale 取值无效: %s，已忽略", profile["locale"].dump().c_str());
+                }
+            }
+            if (profile.contains("props")) {
+                if (profile["props"].is_object()) {
+                    classifyProperties(profile["props"], classified.properties);
+                } else {
+                    LOGW("props 不是对象，已忽略");
+                }
+            }
+            if (profile.contains("deriveProps")) {
+                if (profile["deriveProps"].is_boolean()) {
+                    classified.deriveProperties = profile["deriveProps"].get<bool>();
+                } else {
+                    LOGW("deriveProps 不是布尔值，已忽略");
+                }
+            }
+            if (classified.deriveProperties) {
+                deriveProperties(classified.buildFields, classified.properties);
+            }
+            if (profile.contains("propsMode")) {
+                const json& mode = profile["propsMode"];
+                if (mode == "overlay") {
+                    classified.propertyOverlay = true;
+                } else if (mode != "hook") {
+                    LOGW("propsMode 取值无效: %s，使用 hook", mode.dump().c_str());
+                }
+            }
+            if (profile.contains("files")) {
+                if (profile["files"].is_object()) {
+                    classifyFiles(profile["files"], classified.files);
+                } else {
+                    LOGW("files 不是对象，已忽略");
+                }
+            }
+            if (profile.contains("kernel")) {
+                if (profile["kernel"].is_object()) {
+                    classifyKernel(profile["kernel"], classified.kernel);
+                } else {
+                    LOGW("kernel 不是对象，已忽略");
+                }
+            }
+            const KernelParts& kernel = classified.kernel;
+            bool hasKernel = !kernel.sysname.empty() || !kernel.release.empty() || !kernel.version.empty() ||
+                             !kernel.machine.empty();
+            if (classified.buildFields.empty() && classified.locale.language.empty() && classified.properties.empty() &&
+                classified.files.empty() && !hasKernel) {
+                LOGW("跳过无效的配置项：没有可用的 build 字段、locale、props、files 或 kernel");
+                continue;
+            }
+
+            // hook 模式的 props 在 native 层只覆盖 specialize 前已加载的库, app 自带的库读到的仍是真实值
+            if (!classified.properties.empty() && !classified.propertyOverlay) {
+                LOGW("配置项 %s 的 props 使用 hook 模式，不作用于 app 自带的 native 库；需要时请设置 "
+                     "\"propsMode\": \"overlay\"", profile["targets"].dump().c_str());
+            }
+
+            builder.addProfile(profile, classified);
+            targetBuilder.addProfile(profile, classified);
+            validProfileCount++;
+        }
 
-    if (!loadConfigFromFile(CONFIG_FILE, configJson)) {
-        LOGW("主配置文件加载失败，尝试加载备份文件...");
-        if (!loadConfigFromFile(CONFIG_BACKUP_FILE, configJson)) {
-            LOGE("备份配置文件也无法加载，放弃更新缓存");
+        if (validProfileCount == 0 || builder.targetCount() == 0) {
+            LOGE("没有有效的配置项，保持原有缓存");
             return;
         }
-        LOGW("从备份文件加载配置");
-        usingBackup = true;
+
+        mappedIndex = std::make_unique<ProfileIndex::MappedFile>();
+        if (!writeIndexFile(CONFIG_INDEX_FILE, CONFIG_INDEX_TEMP_FILE, builder.finish(sourceWriteTime)) ||
+            !mappedIndex->map(CONFIG_INDEX_FILE)) {
+            LOGE("编译索引不可用，保持原有缓存");
+            return;
+        }
+        if (!watching || !publishTargetIndex(targetBuilder.finish(sourceWriteTime))) {
+            withdrawTargetIndex();
+        }
+
+        if (!usingBackup) {
+            backupConfigFile();
+        }
     }
 
-    cachedTargetProfileMap.clear();
-    LOGD("清空旧缓存");
+    auto snapshot = std::make_unique<ProfileSnapshot>();
+    snapshot->index = shareIndex(std::move(mappedIndex));
+    // 覆盖页面在 app 进程中从 memfd 映射, 与共享索引一样依赖 memfd
+    if (snapshot->index->fd() >= 0) {
+        buildPropertyOverlays(*snapshot);
+    }
+    [[maybe_unused]] uint32_t targetCount = snapshot->index->view().header().targetCount;
+    companion.profileStore.publish(std::move(snapshot));
+    companion.loadedWriteTime.store(sourceWriteTime, std::memory_order_release);
+    LOGD("配置文件更新，索引已刷新 (第 %llu 代)，精确映射数：%u",
+         static_cast<unsigned long long>(companion.profileStore.currentGeneration()), targetCount);
+}
 
-    size_t validProfileCount = 0;
+inline void watchConfigDirectory(int inotifyFd) {
+    alignas(struct inotify_event) char eventBuffer[4096];
 
-    for (const auto& profile : configJson) {
-        if (!profile.contains("targets") || 
-            !profile["targets"].is_array() || 
-            profile["targets"].empty() ||
-            !profile.contains("build") || 
-            profile["build"].empty()) {
-            LOGW("跳过无效的配置项：targets 或 build 字段不合法");
+    while (true) {
+        ssize_t len = read(inotifyFd, eventBuffer, sizeof(eventBuffer));
+        if (len < 0 && errno == EINTR) {
             continue;
         }
+        if (len <= 0) {
+            LOGE("读取 inotify 事件失败: %s", strerror(errno));
+            break;
+        }
 
-        auto profilePtr = std::make_shared<json>(profile);
+        bool configChanged = false;
+        bool watchRemoved = false;
+        for (char* ptr = eventBuffer; ptr < eventBuffer + len;) {
+            auto* event = reinterpret_cast<struct inotify_event*>(ptr);
+            if (event->mask & (IN_IGNORED | IN_DELETE_SELF | IN_MOVE_SELF)) {
+                watchRemoved = true;
+            } else if (event->len > 0 && strcmp(event->name, CONFIG_FILE_NAME) == 0) {
+                configChanged = true;
+            }
+            ptr += sizeof(struct inotify_event) + event->len;
+        }
 
-        for (const auto& target : profile["targets"]) {
-            std::string targetName = target.get<std::string>();
-            cachedTargetProfileMap[targetName] = profilePtr;
-            LOGD("添加映射: %s -> profile", targetName.c_str());
+        if (configChanged) {
+            LOGD("inotify: 配置文件已变更");
+            updateTargetProfileMapCache();
         }
+        if (watchRemoved) {
+            LOGW("配置目录监视失效: %s", CONFIG_DIR);
+            break;
+        }
+    }
+
+    // 监视失效后退回到每次请求检查修改时间
+    state().configWatcherRunning.store(false, std::memory_order_release);
+    withdrawTargetIndex();
+    close(inotifyFd);
+}
 
-        validProfileCount++;
+// 编译索引与配置文件一致时直接以文件映射发布, 只需 stat 与 mmap. 这一快照以内联方式发送配置记录,
+// 没有属性区覆盖; 共享 memfd 与覆盖镜像由随后的完整加载补上
+inline void publishCompiledIndex() {
+    std::error_code ec;
+    auto writeTime = std::filesystem::last_write_time(CONFIG_FILE, ec);
+    auto mappedIndex = std::make_unique<ProfileIndex::MappedFile>();
+    if (ec || !mappedIndex->map(CONFIG_INDEX_FILE) ||
+        mappedIndex->view().header().sourceWriteTime != writeTime.time_since_epoch().count()) {
+        LOGD("编译索引不可直接使用，等待后台加载");
+        return;
     }
+    auto snapshot = std::make_unique<ProfileSnapshot>();
+    snapshot->index = std::move(mappedIndex);
+    state().profileStore.publish(std::move(snapshot));
+    LOGD("已发布编译索引, 完整加载在后台进行");
+}
 
-    if (validProfileCount == 0) {
-        LOGE("没有有效的配置项，保持原有缓存");
+// 在后台线程中加载配置, 查询继续使用已发布的快照; 已有加载在进行时直接返回.
+// inotifyFd 有效时加载完成后由同一线程开始监视配置目录
+inline void reloadInBackground(int inotifyFd = -1) {
+    if (state().reloadRunning.exchange(true, std::memory_order_acq_rel)) {
+        if (inotifyFd >= 0) {
+            close(inotifyFd);
+        }
         return;
     }
+    std::thread([inotifyFd] {
+        updateTargetProfileMapCache();
+        state().reloadRunning.store(false, std::memory_order_release);
+        if (inotifyFd >= 0) {
+            watchConfigDirectory(inotifyFd);
+        }
+    }).detach();
+}
 
-    lastConfigWriteTime = currentWriteTime;
-    LOGD("配置文件更新，缓存已刷新，总映射数：%zu", cachedTargetProfileMap.size());
+// 未运行监视线程时由每次请求调用: 只 stat 配置文件, 有变化时交给后台加载
+inline void reloadIfChanged() {
+    std::error_code ec;
+    auto writeTime = std::filesystem::last_write_time(CONFIG_FILE, ec);
+    if (!ec && writeTime.time_since_epoch().count() != state().loadedWriteTime.load(std::memory_order_acquire)) {
+        reloadInBackground();
+    }
+}
 
-    if (!usingBackup) {
-        backupConfigFile();
+inline void startConfigWatcher() {
+    static std::once_flag started;
+    std::call_once(started, [] {
+        // 先建立监视再加载, 避免遗漏两者之间的修改
+        int inotifyFd = inotify_init1(IN_CLOEXEC);
+        if (inotifyFd < 0) {
+            LOGE("inotify_init1 失败: %s", strerror(errno));
+        } else if (inotify_add_watch(inotifyFd, CONFIG_DIR,
+                                     IN_CLOSE_WRITE | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF) < 0) {
+            LOGE("无法监视配置目录 %s: %s", CONFIG_DIR, strerror(errno));
+            close(inotifyFd);
+            inotifyFd = -1;
+        } else {
+            state().configWatcherRunning.store(true, std::memory_order_release);
+        }
+
+        // 初次加载 (可能需要编译 JSON 与生成属性区覆盖镜像) 不计入任何客户端的超时预算:
+        // 先发布可直接映射的编译索引, 其余在后台完成, 期间的请求以已发布的快照应答
+        publishCompiledIndex();
+        reloadInBackground(inotifyFd);
+        LOGD("配置在后台加载%s", inotifyFd >= 0 ? ", 随后监视配置目录" : "");
+    });
+}
+
+inline void sendStatus(int fd, Protocol::ResponseStatus status, const Deadline& deadline) {
+    const Protocol::ResponseHeader response = Protocol::makeResponseHeader(status);
+    safeSend(fd, &response, sizeof(response), &deadline);
+}
+
+inline void logRequestReadFailure(const char* what) {
+    if (errno == ETIMEDOUT) {
+        uint64_t timeouts = state().requestTimeouts.fetch_add(1, std::memory_order_relaxed) + 1;
+        LOGW("%s超时 (%u ms), 累计 %llu 次", what, Protocol::REQUEST_TIMEOUT_MS,
+             static_cast<unsigned long long>(timeouts));
+    } else {
+        LOGE("%s失败", what);
     }
 }
 
 inline void FakeDeviceInfoD(int fd) {
     LOGD("Companion 进程启动");
 
-    updateTargetProfileMapCache();
+    State& companion = state();
+    startConfigWatcher();
+    if (companion.configWatcherRunning.load(std::memory_order_acquire)) {
+        [[maybe_unused]] uint64_t skipped = companion.skippedStatCalls.fetch_add(1, std::memory_order_relaxed) + 1;
+        LOGD("配置由 inotify 维护, 已省去 %llu 次 stat 调用", static_cast<unsigned long long>(skipped));
+    } else {
+        reloadIfChanged();
+    }
 
-    uint8_t requestType;
-    int32_t nameSize;
-    if (read(fd, &requestType, 1) != 1 || read(fd, &nameSize, 4) != 4 || nameSize <= 0) {
-        LOGE("读取请求类型或进程名大小失败");
+    Deadline deadline(Protocol::REQUEST_TIMEOUT_MS);
+    Protocol::RequestHeader request{};
+    if (!safeRead(fd, &request, sizeof(request), &deadline)) {
+        logRequestReadFailure("读取请求头");
         return;
     }
-    
-    std::vector<char> nameBuffer(nameSize + 1);
-    if (read(fd, nameBuffer.data(), nameSize) != nameSize) {
-        LOGE("读取进程名失败");
+    if (request.magic != Protocol::MAGIC || request.version == 0) {
+        LOGE("无效的请求头: magic=0x%08x", request.magic);
+        sendStatus(fd, Protocol::STATUS_BAD_REQUEST, deadline);
+        return;
+    }
+    if (request.kind != Protocol::REQUEST_PROFILE) {
+        LOGW("不支持的请求类型: %u (协议版本 %u)", request.kind, request.version);
+        sendStatus(fd, Protocol::STATUS_UNSUPPORTED, deadline);
+        return;
+    }
+    if (request.niceNameLength == 0 || request.niceNameLength > Protocol::MAX_NICE_NAME_LENGTH) {
+        LOGE("无效的进程名长度: %u", request.niceNameLength);
+        sendStatus(fd, Protocol::STATUS_BAD_REQUEST, deadline);
         return;
     }
-    nameBuffer[nameSize] = '\0';
-
-    std::string processName(nameBuffer.data());
-    LOGD("收到查询进程名: %s", processName.c_str());
-
-    auto it = cachedTargetProfileMap.find(processName);
-    if (it == cachedTargetProfileMap.end()) {
-        // LOGD("未匹配到进程: %s", processName.c_str());
 
-        uint8_t responseType = 3;
-        int32_t responseSize = 0;
-        write(fd, &responseType, 1);
-        write(fd, &responseSize, 4);
+    char processName[Protocol::MAX_NICE_NAME_LENGTH + 1];
+    if (!safeRead(fd, processName, request.niceNameLength, &deadline)) {
+        logRequestReadFailure("读取进程名");
         return;
-        LOGD("Companion 进程结束");
     }
+    processName[request.niceNameLength] = '\0';
+    std::string_view processNameView(processName, request.niceNameLength);
+    LOGD("收到查询进程名: %s (uid=%d, child_zygote=%d, caps=0x%x)", processName, request.uid,
+         (request.flags & Protocol::REQUEST_FLAG_CHILD_ZYGOTE) != 0, request.capabilities);
 
-    json response = *(it->second);
-    std::string responseStr = response.dump();
-    int32_t responseSize = static_cast<int32_t>(responseStr.size());
+    auto snapshot = companion.profileStore.read();
+    const ProfileIndex::MappedFile* profileIndex = snapshot ? snapshot->index.get() : nullptr;
+    const ProfileIndex::ProfileRecord* profile = profileIndex ? profileIndex->view().findProfile(processNameView) : nullptr;
+    if (!profile) {
+        if (!snapshot) {
+            LOGW("配置尚未加载完成，按未匹配处理: %s", processName);
+        }
+        // LOGD("未匹配到进程: %s", processName);
+        sendStatus(fd, Protocol::STATUS_NO_MATCH, deadline);
+        LOGD("Companion 进程结束");
+        return;
+    }
 
-    std::vector<uint8_t> responseBuffer(1 + 4 + responseSize);
-    responseBuffer[0] = 2;
-    memcpy(responseBuffer.data() + 1, &responseSize, sizeof(responseSize));
-    memcpy(responseBuffer.data() + 1 + 4, responseStr.data(), responseSize);
+    if (!(request.capabilities & Protocol::CAP_BINARY_PROFILE)) {
+        LOGW("客户端不支持当前配置格式: caps=0x%x", request.capabilities);
+        sendStatus(fd, Protocol::STATUS_UNSUPPORTED, deadline);
+        return;
+    }
 
-    if (write(fd, responseBuffer.data(), responseBuffer.size()) != responseBuffer.size()) {
-        LOGE("发送 JSON 配置失败");
+    if ((request.capabilities & Protocol::CAP_SHARED_PROFILE) && profileIndex->fd() >= 0) {
+        struct {
+            Protocol::ResponseHeader header;
+            Protocol::SharedProfileLocation location;
+            Protocol::PropertyOverlayLocation overlay;
+        } response = {
+            Protocol::makeResponseHeader(Protocol::STATUS_MATCHED, sizeof(Protocol::SharedProfileLocation)),
+            {profileIndex->view().responseFileOffset(*profile) + static_cast<uint32_t>(sizeof(Protocol::ResponseHeader)),
+             profile->responseSize - static_cast<uint32_t>(sizeof(Protocol::ResponseHeader))},
+            {0, 0},
+        };
+        response.header.flags = Protocol::RESPONSE_FLAG_SHARED_PROFILE;
+        int fds[Protocol::MAX_RESPONSE_FDS] = {profileIndex->fd(), snapshot->overlayFd};
+        size_t fdCount = 1;
+        uint32_t profileOrdinal = profileIndex->view().profileIndexOf(*profile);
+        if ((request.capabilities & Protocol::CAP_PROPERTY_OVERLAY) && snapshot->overlayFd >= 0 &&
+            snapshot->overlays[profileOrdinal].size > 0) {
+            response.header.flags |= Protocol::RESPONSE_FLAG_PROPERTY_OVERLAY;
+            response.header.payloadSize += sizeof(Protocol::PropertyOverlayLocation);
+            response.overlay = snapshot->overlays[profileOrdinal];
+            fdCount = 2;
+        }
+        size_t responseSize = sizeof(Protocol::ResponseHeader) + response.header.payloadSize;
+        if (!sendWithFds(fd, &response, responseSize, fds, fdCount, &deadline)) {
+            LOGE("发送配置 memfd 失败");
+        }
+    } else if (!safeSend(fd, profileIndex->view().response(*profile), profile->responseSize, &deadline)) {
+        LOGE("发送配置记录失败");
     }
 
     LOGD("Companion 进程结束");
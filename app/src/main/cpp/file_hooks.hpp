@@ -0,0 +1,176 @@
+#ifndef FILE_HOOKS_HPP
+#define FILE_HOOKS_HPP
+
+#include "utils.hpp"
+#include "plt_hooks.hpp"
+#include "profile_payload.hpp"
+
+#include <cerrno>
+#include <cstdarg>
+#include <cstdio>
+#include <fcntl.h>
+
+// 按 profile 的 files 表虚拟化少量只读文件 (/proc/cpuinfo, /sys/devices/soc0/* 等).
+//
+// 以只读方式打开表中路径时返回装有预生成内容的密封 memfd, 后续 read/lseek/mmap/close 均由内核按普通文件
+// 处理, 因此不 hook read. 每个文件的 memfd 在 specialize 时创建一次并常驻, 每次打开经 /proc/self/fd
+// 重新打开它, 得到独立的打开文件描述与偏移, 不再逐次创建与写入; 重新打开失败 (如被 SELinux 拒绝) 时
+// 才为本次打开单独创建. 其余打开只多一次路径哈希探测.
+// libc 内部 (如 fopen) 直接调用 open 而不经过 PLT, 所以 fopen 单独 hook.
+namespace FileHooks {
+
+inline ProfilePayload::View files;
+
+// readlink(/proc/self/fd/N) 显示 "/memfd:<名称> (deleted)". 不使用文件名, 而是沿用 ART 在 app 进程中
+// 为 JIT 代码缓存创建的 memfd 名称
+constexpr const char* MEMFD_NAME = "jit-cache";
+
+// 下标与 files 中的虚拟文件一致, 创建失败的为 -1
+constexpr size_t MAX_SHARED_FILES = 16;
+inline int sharedFds[MAX_SHARED_FILES];
+inline size_t sharedFdCount = 0;
+
+// bionic 中 open64/openat64/fopen64 是 open/openat/fopen 的别名, 共用同一个原函数指针
+inline int (*originalOpen)(const char*, int, ...) = nullptr;
+inline int (*originalOpenat)(int, const char*, int, ...) = nullptr;
+inline int (*originalOpen2)(const char*, int) = nullptr;
+inline int (*originalOpenat2)(int, const char*, int) = nullptr;
+inline FILE* (*originalFopen)(const char*, const char*) = nullptr;
+
+inline bool needsMode(int flags) {
+    return (flags & O_CREAT) || (flags & O_TMPFILE) == O_TMPFILE;
+}
+
+// 创建写入 content 并已密封的 memfd, 失败时返回 -1
+inline int createVirtualFile(std::string_view content, bool closeOnExec) {
+    int fd = createMemfd(MEMFD_NAME, MFD_ALLOW_SEALING | (closeOnExec ? MFD_CLOEXEC : 0));
+    if (fd < 0) {
+        return -1;
+    }
+    if (!safeWrite(fd, content.data(), content.size()) || lseek(fd, 0, SEEK_SET) != 0 ||
+        fcntl(fd, F_ADD_SEALS, FULL_MEMFD_SEALS) != 0) {
+        int error = errno;
+        close(fd);
+        errno = error;
+        return -1;
+    }
+    return fd;
+}
+
+// 路径被虚拟化且以只读方式打开时返回装有其内容的 memfd, 否则返回 -1 (不改变 errno), 由调用方转发给原函数
+inline int openVirtual(const char* path, int flags) {
+    if (!path || path[0] != '/' || (flags & O_ACCMODE) != O_RDONLY ||
+        (flags & (O_CREAT | O_TRUNC | O_DIRECTORY | O_PATH))) {
+        return -1;
+    }
+    const ProfilePayload::FileEntry* entry = files.findFile(path);
+    if (!entry) {
+        return -1;
+    }
+    int savedErrno = errno;
+    size_t index = files.fileIndex(*entry);
+    if (index < sharedFdCount && sharedFds[index] >= 0) {
+        char sharedPath[32];
+        snprintf(sharedPath, sizeof(sharedPath), "/proc/self/fd/%d", sharedFds[index]);
+        int fd = open(sharedPath, O_RDONLY | (flags & O_CLOEXEC));
+        if (fd >= 0) {
+            return fd;
+        }
+        errno = savedErrno;
+    }
+    int fd = createVirtualFile(files.fileContent(*entry), flags & O_CLOEXEC);
+    if (fd < 0) {
+        LOGW("无法为虚拟文件 %s 创建 memfd: %s，使用原文件", path, strerror(errno));
+        errno = savedErrno;
+        return -1;
+    }
+    return fd;
+}
+
+inline int hookedOpen(const char* path, int flags, ...) {
+    int fd = openVirtual(path, flags);
+    if (fd >= 0) {
+        return fd;
+    }
+    mode_t mode = 0;
+    if (needsMode(flags)) {
+        va_list args;
+        va_start(args, flags);
+        mode = static_cast<mode_t>(va_arg(args, int));
+        va_end(args);
+    }
+    return originalOpen(path, flags, mode);
+}
+
+// 相对路径取决于 dirfd, 不做虚拟化
+inline int hookedOpenat(int dirFd, const char* path, int flags, ...) {
+    int fd = openVirtual(path, flags);
+    if (fd >= 0) {
+        return fd;
+    }
+    mode_t mode = 0;
+    if (needsMode(flags)) {
+        va_list args;
+        va_start(args, flags);
+        mode = static_cast<mode_t>(va_arg(args, int));
+        va_end(args);
+    }
+    return originalOpenat(dirFd, path, flags, mode);
+}
+
+// _FORTIFY_SOURCE 下不带 mode 的 open/openat 调用被编译为以下两个函数
+inline int hookedOpen2(const char* path, int flags) {
+    int fd = openVirtual(path, flags);
+    return fd >= 0 ? fd : originalOpen2(path, flags);
+}
+
+inline int hookedOpenat2(int dirFd, const char* path, int flags) {
+    int fd = openVirtual(path, flags);
+    return fd >= 0 ? fd : originalOpenat2(dirFd, path, flags);
+}
+
+inline FILE* hookedFopen(const char* path, const char* mode) {
+    if (mode && mode[0] == 'r' && !strchr(mode, '+')) {
+        int fd = openVirtual(path, strchr(mode, 'e') ? O_RDONLY | O_CLOEXEC : O_RDONLY);
+        if (fd >= 0) {
+            FILE* file = fdopen(fd, mode);
+            if (file) {
+                return file;
+            }
+            close(fd);
+        }
+    }
+    return originalFopen(path, mode);
+}
+
+// 为每个虚拟文件创建常驻的 memfd, 并豁免 specialize 结束时的 fd 清理
+inline void createSharedFiles(zygisk::Api* api) {
+    sharedFdCount = std::min(files.fileCount(), MAX_SHARED_FILES);
+    for (size_t i = 0; i < sharedFdCount; i++) {
+        int fd = createVirtualFile(files.fileContent(files.fileAt(i)), true);
+        if (fd >= 0 && !api->exemptFd(fd)) {
+            close(fd);
+            fd = -1;
+        }
+        sharedFds[i] = fd;
+    }
+}
+
+// 登记文件相关的 PLT hook, 由调用方统一提交. profile 必须在进程生命周期内有效; 只能在 preAppSpecialize 中调用
+inline void install(zygisk::Api* api, const ProfilePayload::View& profile) {
+    files = profile;
+    createSharedFiles(api);
+    PltHooks::add("open", reinterpret_cast<void*>(hookedOpen), reinterpret_cast<void**>(&originalOpen));
+    PltHooks::add("open64", reinterpret_cast<void*>(hookedOpen), reinterpret_cast<void**>(&originalOpen));
+    PltHooks::add("openat", reinterpret_cast<void*>(hookedOpenat), reinterpret_cast<void**>(&originalOpenat));
+    PltHooks::add("openat64", reinterpret_cast<void*>(hookedOpenat), reinterpret_cast<void**>(&originalOpenat));
+    PltHooks::add("__open_2", reinterpret_cast<void*>(hookedOpen2), reinterpret_cast<void**>(&originalOpen2));
+    PltHooks::add("__openat_2", reinterpret_cast<void*>(hookedOpenat2), reinterpret_cast<void**>(&originalOpenat2));
+    PltHooks::add("fopen", reinterpret_cast<void*>(hookedFopen), reinterpret_cast<void**>(&originalFopen));
+    PltHooks::add("fopen64", reinterpret_cast<void*>(hookedFopen), reinterpret_cast<void**>(&originalFopen));
+    LOGD("已登记文件 hook, 虚拟化 %zu 个文件", files.fileCount());
+}
+
+} // namespace FileHooks
+
+#endif // FILE_HOOKS_HPP
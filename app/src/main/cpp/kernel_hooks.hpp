@@ -0,0 +1,50 @@
+#ifndef KERNEL_HOOKS_HPP
+#define KERNEL_HOOKS_HPP
+
+#include "utils.hpp"
+#include "plt_hooks.hpp"
+#include "profile_payload.hpp"
+
+#include <cerrno>
+#include <sys/utsname.h>
+
+// 按 profile 的 kernel 字段伪装 uname(). specialize 时以真实结果为底一次性生成完整的 utsname,
+// hook 中只需一次 memcpy. nodename (主机名) 等未伪装的字段同样取自 specialize 时刻.
+namespace KernelHooks {
+
+inline utsname spoofed;
+inline int (*originalUname)(utsname*) = nullptr;
+
+inline int hookedUname(utsname* buf) {
+    if (!buf) {
+        return originalUname(buf);
+    }
+    memcpy(buf, &spoofed, sizeof(spoofed));
+    return 0;
+}
+
+// 空串表示保留真实值; 长度已在 attach 时确认小于字段长度, strncpy 同时清零原值的剩余部分
+inline void replaceField(char (&field)[sizeof(utsname::release)], const char* value) {
+    if (*value) {
+        strncpy(field, value, sizeof(field));
+    }
+}
+
+// 生成伪装后的 utsname 并登记 uname 的 PLT hook, 由调用方统一提交
+inline void install(const ProfilePayload::View& profile) {
+    if (uname(&spoofed) != 0) {
+        LOGE("uname 失败: %s", strerror(errno));
+        return;
+    }
+    const ProfilePayload::Kernel kernel = profile.kernel();
+    replaceField(spoofed.sysname, kernel.sysname);
+    replaceField(spoofed.release, kernel.release);
+    replaceField(spoofed.version, kernel.version);
+    replaceField(spoofed.machine, kernel.machine);
+    PltHooks::add("uname", reinterpret_cast<void*>(hookedUname), reinterpret_cast<void**>(&originalUname));
+    LOGD("已登记 uname hook: %s %s", spoofed.release, spoofed.version);
+}
+
+} // namespace KernelHooks
+
+#endif // KERNEL_HOOKS_HPP
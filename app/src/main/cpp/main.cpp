@@ -1,8 +1,15 @@
 #include "utils.hpp"
 #include "zygisk.hpp"
+#include "build_fields.hpp"
 #include "companion.hpp"
-
-using json = nlohmann::json;
+#include "profile_index.hpp"
+#include "profile_payload.hpp"
+#include "file_hooks.hpp"
+#include "kernel_hooks.hpp"
+#include "plt_hooks.hpp"
+#include "property_area.hpp"
+#include "property_hooks.hpp"
+#include "protocol.hpp"
 
 class FakeDeviceInfo : public zygisk::ModuleBase {
 public:
@@ -10,161 +17,701 @@ public:
         this->api = api;
         this->env = env;
         LOGD("FakeDeviceInfo 模块加载成功");
+        // 静态初始化已在加载时完成, 此时的 Private_Dirty 即重定位与静态初始化写入的页面
+        logFootprint("onLoad");
     }
 
     void preAppSpecialize(zygisk::AppSpecializeArgs *args) override {
         LOGD("启动 preAppSpecialize");
         
-        const char *processName = env->GetStringUTFChars(args->nice_name, nullptr);
-        if (!processName) {
-            LOGE("无法获取进程名称");
+        // 整个 spawn 路径只使用栈上的缓冲区, 不做堆分配
+        char processName[Protocol::MAX_NICE_NAME_LENGTH + 1];
+        if (!readNiceName(env, args->nice_name, processName)) {
+            unloadIfIdle();
             return;
         }
         LOGD("当前进程名称: %s", processName);
+
+        timings = {};
+        timings.start = monotonicNanos();
+        jniCalls = 0;
+        // 配置记录直接在接收缓冲区或共享映射中遍历, 两者都要活到字段写完
+        alignas(8) uint8_t responseBuffer[RESPONSE_BUFFER_SIZE];
+        MappedRegion sharedRegion;
+        ProfilePayload::View profile;
+        if (fetchProfile(args, processName, responseBuffer, sharedRegion, profile)) {
+            [[maybe_unused]] std::string_view profileName = profile.name();
+            LOGD("匹配到配置项: %.*s, Build 伪装参数 %zu 个", static_cast<int>(profileName.size()),
+                 profileName.data(), profile.fieldCount());
+            timings.parsed = monotonicNanos();
+
+            if (profile.fieldCount() > 0) {
+                resolveProfileFields(profile);
+                UpdateBuildFields(profile);
+            }
+            timings.applied = monotonicNanos();
+            if (profile.hasLocale()) {
+                applyLocale(profile.locale());
+            }
+            timings.localeApplied = monotonicNanos();
+            installHooks(profile);
+            timings.hooked = monotonicNanos();
+            logTimings(profile);
+        }
+        if (overlayFd >= 0) {
+            close(overlayFd);
+            overlayFd = -1;
+        }
+        releaseBuildTable();
+        unloadIfIdle();
+        LOGD("preAppSpecialize 处理完成");
+    }
     
+    void preServerSpecialize(zygisk::ServerSpecializeArgs *args) override {
+        api->setOption(zygisk::DLCLOSE_MODULE_LIBRARY);
+    }
+
+private:
+    zygisk::Api *api = nullptr;
+    JNIEnv *env = nullptr;
+    // 安装了必须常驻的 hook 时置位, 否则 specialize 结束后即从 app 进程卸载本模块
+    bool keepResident = false;
+    // 内联响应 (未使用共享 memfd 时) 的接收缓冲区大小, 超出的配置记录视为无效
+    static constexpr size_t RESPONSE_BUFFER_SIZE = 16 * 1024;
+
+    // 每次 spawn 只解析一次的类与字段 ID, 下标与 BuildFields::DESCRIPTORS 一致;
+    // 配置中的键经 BuildFields::indexOf 的完美哈希直接定位到表项
+    jclass buildClasses[BuildFields::CLASS_COUNT] = {};
+    jfieldID buildFieldIds[BuildFields::DESCRIPTOR_COUNT] = {};
+    // 已尝试过 FindClass 的类 (失败时不重复查找)
+    bool buildClassTried[BuildFields::CLASS_COUNT] = {};
+    // 已在等待 Companion 期间解析了整张表
+    bool buildTableResolved = false;
+    // 仅在需要写入字符串数组字段时解析
+    jclass stringClass = nullptr;
+    // 本次 spawn 中 Build 伪装路径发出的 JNI 调用次数
+    uint32_t jniCalls = 0;
+
+    // 各阶段结束时刻 (CLOCK_MONOTONIC, 纳秒)
+    struct SpawnTimings {
+        uint64_t start;
+        uint64_t connected;
+        uint64_t sent;
+        uint64_t resolved;
+        uint64_t received;
+        uint64_t parsed;
+        uint64_t applied;
+        uint64_t localeApplied;
+        uint64_t hooked;
+    } timings = {};
+    // 本次 spawn 收到的属性区覆盖镜像 memfd 及其位置, 没有时为 -1
+    int overlayFd = -1;
+    Protocol::PropertyOverlayLocation overlayLocation = {};
+    // 本次 spawn 与 Companion 交互的时间预算 (毫秒)
+    uint32_t ipcTimeoutMs = Protocol::DEFAULT_IPC_TIMEOUT_MS;
+
+    // Build 字段写入后由 Java 堆持有, 不再引用本模块的代码或数据;
+    // 未匹配与已完成伪装的进程都无需保留整个 .so (含 json 解析代码) 的映射
+    void unloadIfIdle() {
+        logFootprint(keepResident ? "常驻" : "卸载前");
+        if (keepResident) {
+            LOGD("存在常驻 hook，保留模块");
+            return;
+        }
+        api->setOption(zygisk::DLCLOSE_MODULE_LIBRARY);
+    }
+
+    // 调试构建中记录本模块在当前进程中的映射占用; 卸载时省下的就是这部分
+    static void logFootprint([[maybe_unused]] const char *when) {
+#ifdef DEBUG
+        MappingFootprint footprint;
+        if (readElfFootprint(reinterpret_cast<const void *>(&logFootprint), footprint)) {
+            LOGD("模块映射 (%s): Size %llu kB, Rss %llu kB, Pss %llu kB, Private_Clean %llu kB, Private_Dirty %llu kB",
+                 when, static_cast<unsigned long long>(footprint.size), static_cast<unsigned long long>(footprint.rss),
+                 static_cast<unsigned long long>(footprint.pss),
+                 static_cast<unsigned long long>(footprint.privateClean),
+                 static_cast<unsigned long long>(footprint.privateDirty));
+        }
+#endif
+    }
+
+    // 模块目录中 target 索引的预筛结果
+    enum class TargetFilter {
+        UNKNOWN, // 索引不存在或无效, 交由 Companion 判断
+        HIT,
+        MISS,
+    };
+
+    // 向 Companion 查询进程对应的配置, 未匹配或出错时返回 false
+    bool fetchProfile(zygisk::AppSpecializeArgs *args, const char *processName, uint8_t *responseBuffer,
+                      MappedRegion &sharedRegion, ProfilePayload::View &profile) {
+        TargetFilter filter = filterTarget(processName);
+        if (filter == TargetFilter::MISS) {
+            LOGD("target 索引未命中: %s，跳过 Companion", processName);
+            return false;
+        }
+
+        size_t nameSize = strlen(processName);
+
+        // 预算从连接前开始计算; connectCompanion 本身由 Zygisk 实现, 无法中途放弃,
+        // 其后的每次收发都以剩余预算为上限
+        ipcTimeoutMs = readIpcTimeout();
+        Deadline deadline(ipcTimeoutMs);
         int fd = api->connectCompanion();
         if (fd < 0) {
             LOGE("连接 Companion 失败，fd: %d", fd);
-            env->ReleaseStringUTFChars(args->nice_name, processName);
-            return;
+            return false;
         }
-    
-        uint8_t type = 1;
-        int32_t nameSize = static_cast<int32_t>(strlen(processName));
-        std::vector<uint8_t> requestBuffer(1 + 4 + nameSize);
-        requestBuffer[0] = type;
-        memcpy(requestBuffer.data() + 1, &nameSize, sizeof(nameSize));
-        memcpy(requestBuffer.data() + 1 + 4, processName, nameSize);
-    
-        if (write(fd, requestBuffer.data(), requestBuffer.size()) != requestBuffer.size()) {
-            LOGE("发送 Process Name 失败");
-            close(fd);
-            env->ReleaseStringUTFChars(args->nice_name, processName);
-            return;
+        timings.connected = monotonicNanos();
+        bool matched = exchangeProfile(fd, args, processName, nameSize, filter == TargetFilter::HIT, deadline,
+                                       responseBuffer, sharedRegion, profile);
+        close(fd);
+        return matched;
+    }
+
+    static uint32_t readIpcTimeout() {
+        char value[PROP_VALUE_MAX] = {};
+        uint32_t timeoutMs = Protocol::DEFAULT_IPC_TIMEOUT_MS;
+        int length = __system_property_get(Protocol::IPC_TIMEOUT_PROPERTY, value);
+        if (length > 0) {
+            uint32_t parsed = 0;
+            auto [end, ec] = std::from_chars(value, value + length, parsed);
+            if (ec == std::errc() && end == value + length) {
+                timeoutMs = std::clamp(parsed, Protocol::MIN_IPC_TIMEOUT_MS, Protocol::MAX_IPC_TIMEOUT_MS);
+            }
+        }
+        return timeoutMs;
+    }
+
+    // I/O 失败时区分超时与连接异常; 超时意味着本次放弃伪装
+    void logIpcFailure(const char *what) {
+        if (errno == ETIMEDOUT) {
+            LOGW("%s超时 (预算 %u ms, 已耗时 %llu us)，跳过伪装", what, ipcTimeoutMs,
+                 static_cast<unsigned long long>((monotonicNanos() - timings.start) / 1000));
+        } else {
+            LOGE("%s失败: %s", what, strerror(errno));
+        }
+    }
+
+    bool exchangeProfile(int fd, zygisk::AppSpecializeArgs *args, const char *processName, size_t nameSize,
+                         bool likelyMatch, const Deadline &deadline, uint8_t *responseBuffer, MappedRegion &sharedRegion,
+                         ProfilePayload::View &profile) {
+        uint8_t requestBuffer[Protocol::MAX_REQUEST_SIZE];
+        Protocol::RequestHeader request{};
+        request.magic = Protocol::MAGIC;
+        request.version = Protocol::VERSION;
+        request.kind = Protocol::REQUEST_PROFILE;
+        if (args->is_child_zygote && *args->is_child_zygote) {
+            request.flags |= Protocol::REQUEST_FLAG_CHILD_ZYGOTE;
+        }
+        request.capabilities = Protocol::CAP_BINARY_PROFILE | Protocol::CAP_SHARED_PROFILE |
+                               Protocol::CAP_PROPERTY_OVERLAY;
+        request.uid = args->uid;
+        request.niceNameLength = static_cast<uint16_t>(nameSize);
+        memcpy(requestBuffer, &request, sizeof(request));
+        memcpy(requestBuffer + sizeof(request), processName, nameSize);
+
+        if (!safeSend(fd, requestBuffer, sizeof(request) + nameSize, &deadline)) {
+            logIpcFailure("发送 Process Name");
+            return false;
         }
         LOGD("已发送 Process Name: %s", processName);
-    
-        uint8_t responseType;
-        int32_t responseSize;
-        if (read(fd, &responseType, 1) != 1 || read(fd, &responseSize, 4) != 4) {
+        timings.sent = monotonicNanos();
+
+        // 索引已确认命中时, 在 Companion 处理请求的同时解析整张 JNI 字段表, 两段等待相互重叠.
+        // 没有索引时大多数进程都会走到这里且不匹配, 只在匹配后解析配置用到的字段
+        if (likelyMatch) {
+            resolveBuildTable();
+        }
+        timings.resolved = monotonicNanos();
+
+        // 响应由 Companion 一次写出, 常见大小的配置一次 recv 即可收完
+        int fds[Protocol::MAX_RESPONSE_FDS];
+        ssize_t received = recvWithFds(fd, responseBuffer, RESPONSE_BUFFER_SIZE, fds, std::size(fds), &deadline);
+        if (received < 0) {
+            logIpcFailure("接收响应");
+            return false;
+        }
+        int sharedFd = fds[0];
+        overlayFd = fds[1];
+        // 极少数情况下响应头被拆开送达, 补齐剩余部分
+        if (received > 0 && received < static_cast<ssize_t>(sizeof(Protocol::ResponseHeader))) {
+            if (!safeRead(fd, responseBuffer + received, sizeof(Protocol::ResponseHeader) - received, &deadline)) {
+                logIpcFailure("接收响应头");
+                if (sharedFd >= 0) {
+                    close(sharedFd);
+                }
+                return false;
+            }
+            received = sizeof(Protocol::ResponseHeader);
+        }
+        timings.received = monotonicNanos();
+        bool matched = parseResponse(fd, responseBuffer, received, sharedFd, deadline, sharedRegion, profile);
+        if (sharedFd >= 0) {
+            close(sharedFd);
+        }
+        return matched;
+    }
+
+    bool parseResponse(int fd, uint8_t *responseBuffer, ssize_t received, int sharedFd, const Deadline &deadline,
+                       MappedRegion &sharedRegion, ProfilePayload::View &profile) {
+        Protocol::ResponseHeader response{};
+        if (received < static_cast<ssize_t>(sizeof(response))) {
             LOGE("读取响应头失败");
-            close(fd);
-            env->ReleaseStringUTFChars(args->nice_name, processName);
-            return;
+            return false;
         }
-    
-        if (responseType == 3) {
-            LOGD("Companion 未匹配到进程: %s，跳过伪装", processName);
-            close(fd);
-            env->ReleaseStringUTFChars(args->nice_name, processName);
-            return;
+        memcpy(&response, responseBuffer, sizeof(response));
+
+        if (!Protocol::isValidResponse(response)) {
+            LOGE("无效的响应头: magic=0x%08x, version=%u", response.magic, response.version);
+            return false;
         }
-    
-        LOGD("接收到响应大小: %d", responseSize);
-        if (responseSize <= 0) {
-            LOGE("无效的 JSON 数据大小");
-            close(fd);
-            env->ReleaseStringUTFChars(args->nice_name, processName);
-            return;
+
+        if (response.status == Protocol::STATUS_NO_MATCH) {
+            LOGD("Companion 未匹配到进程，跳过伪装");
+            return false;
         }
-    
-        std::vector<uint8_t> responseBuffer(responseSize);
-        if (read(fd, responseBuffer.data(), responseSize) != responseSize) {
-            LOGE("读取 JSON 配置失败");
-            close(fd);
-            env->ReleaseStringUTFChars(args->nice_name, processName);
-            return;
+
+        LOGD("接收到响应状态: %u, 大小: %u", response.status, response.payloadSize);
+        if (response.status != Protocol::STATUS_MATCHED || response.payloadSize == 0) {
+            LOGE("无效的响应: status=%u, size=%u", response.status, response.payloadSize);
+            return false;
         }
-        close(fd);
-    
-        json profileJson = json::parse(responseBuffer, nullptr, false);
-        if (!profileJson.is_object()) {
-            LOGE("解析 JSON 失败或不是对象");
-            env->ReleaseStringUTFChars(args->nice_name, processName);
+
+        size_t alreadyReceived = std::min<size_t>(received - sizeof(response), response.payloadSize);
+        uint8_t *payload = responseBuffer + sizeof(response);
+
+        if (response.flags & Protocol::RESPONSE_FLAG_SHARED_PROFILE) {
+            Protocol::SharedProfileLocation location{};
+            size_t expectedSize = sizeof(location);
+            if (response.flags & Protocol::RESPONSE_FLAG_PROPERTY_OVERLAY) {
+                expectedSize += sizeof(overlayLocation);
+            }
+            if (sharedFd < 0 || response.payloadSize != expectedSize) {
+                LOGE("共享配置响应无效");
+                return false;
+            }
+            // 与内联配置记录相同, 位置信息与响应头分开送达时补齐剩余部分
+            if (!safeRead(fd, payload + alreadyReceived, expectedSize - alreadyReceived, &deadline)) {
+                logIpcFailure("读取共享配置位置");
+                return false;
+            }
+            memcpy(&location, payload, sizeof(location));
+            if (expectedSize > sizeof(location)) {
+                memcpy(&overlayLocation, payload + sizeof(location), sizeof(overlayLocation));
+            } else if (overlayFd >= 0) {
+                close(overlayFd);
+                overlayFd = -1;
+            }
+
+            // 只接受已完全密封的 memfd, 保证映射期间内容不会被修改或截断
+            if (!isFullySealed(sharedFd) || !sharedRegion.map(sharedFd, location.offset, location.size)) {
+                LOGE("无法映射共享配置: offset=%u, size=%u", location.offset, location.size);
+                return false;
+            }
+            if (!profile.attach(sharedRegion.data(), sharedRegion.size())) {
+                LOGE("共享配置记录无效");
+                return false;
+            }
+        } else {
+            if (response.payloadSize > RESPONSE_BUFFER_SIZE - sizeof(response)) {
+                LOGE("配置记录过大: %u", response.payloadSize);
+                return false;
+            }
+            if (!safeRead(fd, payload + alreadyReceived, response.payloadSize - alreadyReceived, &deadline)) {
+                logIpcFailure("读取配置记录");
+                return false;
+            }
+            if (!profile.attach(payload, response.payloadSize)) {
+                LOGE("配置记录无效");
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // 把 Companion 生成的覆盖页面映射到本进程的属性区上, 返回完成覆盖的属性数
+    uint32_t applyPropertyOverlay(const ProfilePayload::View &profile) {
+        if (overlayFd < 0 || !profile.usesPropertyOverlay()) {
+            return 0;
+        }
+        // 页面映射自同一 memfd, 同样只接受已完全密封的
+        MappedRegion directory;
+        PropertyArea::OverlayView overlay;
+        if (!isFullySealed(overlayFd) || !directory.map(overlayFd, overlayLocation.offset, overlayLocation.size) ||
+            !overlay.attach(directory.data(), directory.size())) {
+            LOGE("属性区覆盖镜像无效: offset=%u, size=%u", overlayLocation.offset, overlayLocation.size);
+            return 0;
+        }
+        return PropertyArea::applyOverlay(profile, overlay, overlayFd, overlayLocation.offset);
+    }
+
+    // 安装配置需要的全部 hook. 属性区覆盖完整生效时无需属性 hook, 否则由 hook 提供全部 props
+    void installHooks(const ProfilePayload::View &profile) {
+        bool needsPropertyHooks =
+            profile.propertyCount() > 0 && applyPropertyOverlay(profile) < profile.propertyCount();
+        // uname 的结果在此生成, 不引用配置记录
+        if (profile.hasKernel()) {
+            KernelHooks::install(profile);
+        }
+        // 其余 hook 在 specialize 之后仍要访问配置记录, 接收缓冲区与共享映射都不能满足
+        ProfilePayload::View resident;
+        if ((needsPropertyHooks || profile.fileCount() > 0) && copyResident(profile, resident)) {
+            if (needsPropertyHooks && PropertyHooks::install(api, env, resident)) {
+                keepResident = true;
+            }
+            if (profile.fileCount() > 0) {
+                FileHooks::install(api, resident);
+            }
+        }
+        if (PltHooks::commit(api)) {
+            keepResident = true;
+        }
+    }
+
+    // 把配置记录复制为常驻的只读匿名映射
+    static bool copyResident(const ProfilePayload::View &profile, ProfilePayload::View &resident) {
+        void *copy = mmap(nullptr, profile.size(), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (copy == MAP_FAILED) {
+            LOGE("无法为常驻配置记录分配内存: %s", strerror(errno));
+            return false;
+        }
+        memcpy(copy, profile.data(), profile.size());
+        mprotect(copy, profile.size(), PROT_READ);
+        if (!resident.attach(static_cast<const uint8_t *>(copy), profile.size())) {
+            munmap(copy, profile.size());
+            return false;
+        }
+        return true;
+    }
+
+    // 用 Companion 发布在模块目录的 target 索引本地预筛, 未命中的进程无需连接 Companion
+    TargetFilter filterTarget(const char *processName) {
+        int moduleDir = api->getModuleDir();
+        if (moduleDir < 0) {
+            return TargetFilter::UNKNOWN;
+        }
+        int indexFd = openat(moduleDir, TARGET_INDEX_FILE_NAME, O_RDONLY | O_CLOEXEC);
+        if (indexFd < 0) {
+            return TargetFilter::UNKNOWN;
+        }
+
+        ProfileIndex::MappedFile targetIndex;
+        bool mapped = targetIndex.mapFd(indexFd);
+        close(indexFd);
+        if (!mapped || !(targetIndex.view().header().flags & ProfileIndex::INDEX_FLAG_TARGETS_ONLY)) {
+            LOGW("target 索引无效，交由 Companion 匹配");
+            return TargetFilter::UNKNOWN;
+        }
+        return targetIndex.view().findProfile(processName) ? TargetFilter::HIT : TargetFilter::MISS;
+    }
+
+    static int readSdkInt() {
+        char sdkValue[PROP_VALUE_MAX] = {};
+        __system_property_get("ro.build.version.sdk", sdkValue);
+        return atoi(sdkValue);
+    }
+
+    jclass resolveClass(BuildFields::FieldClass fieldClass) {
+        if (!buildClassTried[fieldClass]) {
+            buildClassTried[fieldClass] = true;
+            buildClasses[fieldClass] = env->FindClass(BuildFields::CLASS_NAMES[fieldClass]);
+            jniCalls++;
+            if (!buildClasses[fieldClass]) {
+                env->ExceptionClear();
+                LOGE("无法找到类 %s", BuildFields::CLASS_NAMES[fieldClass]);
+            }
+        }
+        return buildClasses[fieldClass];
+    }
+
+    // 按 API 级别过滤, 避免为不存在的字段触发 NoSuchFieldError
+    void resolveField(size_t index, int sdkInt) {
+        const BuildFields::Descriptor &descriptor = BuildFields::DESCRIPTORS[index];
+        jclass fieldClass = resolveClass(descriptor.fieldClass);
+        if (!fieldClass || descriptor.minSdk > sdkInt || buildFieldIds[index]) {
             return;
         }
-    
-        LOGD("匹配到配置项: %s", profileJson["name"].get<std::string>().c_str());
-    
-        if (profileJson.contains("build") && profileJson["build"].is_object()) {
-            spoofBuild = profileJson["build"].get<std::unordered_map<std::string, std::string>>();
-            LOGD("获取到 %zu 个 Build 伪装参数", spoofBuild.size());
+        buildFieldIds[index] = env->GetStaticFieldID(fieldClass, descriptor.name.data(),
+                                                     BuildFields::signature(descriptor.type));
+        jniCalls += 2;
+        if (env->ExceptionCheck()) {
+            env->ExceptionClear();
+            buildFieldIds[index] = nullptr;
+            LOGD("字段 %s 不存在或无法修改", descriptor.name.data());
         }
-    
-        if (!spoofBuild.empty()) {
-            UpdateBuildFields();
+    }
+
+    // 解析当前系统上存在的全部已知字段
+    void resolveBuildTable() {
+        int sdkInt = readSdkInt();
+        for (size_t i = 0; i < BuildFields::DESCRIPTOR_COUNT; i++) {
+            resolveField(i, sdkInt);
         }
-    
-        env->ReleaseStringUTFChars(args->nice_name, processName);
-        LOGD("preAppSpecialize 处理完成");
+        buildTableResolved = true;
     }
-    
-    void preServerSpecialize(zygisk::ServerSpecializeArgs *args) override {
-        api->setOption(zygisk::DLCLOSE_MODULE_LIBRARY);
+
+    // 只解析配置中出现的字段; 整张表已在等待 Companion 时解析过则无需再做
+    void resolveProfileFields(const ProfilePayload::View &profile) {
+        if (buildTableResolved) {
+            return;
+        }
+        int sdkInt = readSdkInt();
+        for (size_t i = 0; i < profile.fieldCount(); i++) {
+            int index = BuildFields::indexOf(profile.field(i).name);
+            if (index >= 0) {
+                resolveField(static_cast<size_t>(index), sdkInt);
+            }
+        }
     }
 
-private:
-    zygisk::Api *api = nullptr;
-    JNIEnv *env = nullptr;
-    std::unordered_map<std::string, std::string> spoofBuild;
-    std::string spoofLocale;
+    void releaseBuildTable() {
+        for (jclass &clazz : buildClasses) {
+            if (clazz) {
+                env->DeleteLocalRef(clazz);
+                clazz = nullptr;
+            }
+        }
+        std::fill(std::begin(buildFieldIds), std::end(buildFieldIds), nullptr);
+        std::fill(std::begin(buildClassTried), std::end(buildClassTried), false);
+        buildTableResolved = false;
+        if (stringClass) {
+            env->DeleteLocalRef(stringClass);
+            stringClass = nullptr;
+        }
+    }
 
-    void UpdateBuildFields() {
+    void logTimings(const ProfilePayload::View &profile) const {
+        [[maybe_unused]] auto micros = [](uint64_t from, uint64_t to) {
+            return to > from ? static_cast<unsigned long long>((to - from) / 1000) : 0ull;
+        };
+        LOGD("耗时(us): 连接 %llu, 发送 %llu, JNI 解析 %llu, 等待响应 %llu, 解析配置 %llu, 写入字段 %llu, "
+             "设置语言 %llu, 安装 hook %llu, 总计 %llu",
+             micros(timings.start, timings.connected), micros(timings.connected, timings.sent),
+             micros(timings.sent, timings.resolved), micros(timings.resolved, timings.received),
+             micros(timings.received, timings.parsed), micros(timings.parsed, timings.applied),
+             micros(timings.applied, timings.localeApplied), micros(timings.localeApplied, timings.hooked),
+             micros(timings.start, timings.hooked));
+        LOGD("JNI 调用: %u 次, 伪装字段 %zu 个", jniCalls, profile.fieldCount());
+    }
+
+    void UpdateBuildFields(const ProfilePayload::View &profile) {
         LOGD("执行 UpdateBuildFields");
-        jclass buildClass = env->FindClass("android/os/Build");
-        jclass versionClass = env->FindClass("android/os/Build$VERSION");
 
-        for (auto &[key, val] : spoofBuild) {
-            LOGD("处理字段: %s -> %s", key.c_str(), val.c_str());
-            const char *fieldName = key.c_str();
-            jfieldID fieldID = nullptr;
-            bool isStringField = true;
+        for (size_t i = 0; i < profile.fieldCount(); i++) {
+            const ProfilePayload::Field field = profile.field(i);
+            // 记录中的字符串均以 '\0' 结尾
+            const char *fieldName = field.name.data();
+            int index = BuildFields::indexOf(field.name);
+            if (index < 0 || BuildFields::DESCRIPTORS[index].fieldClass != field.fieldClass ||
+                BuildFields::DESCRIPTORS[index].type != field.type) {
+                LOGW("字段 %s 与描述表不一致", fieldName);
+                continue;
+            }
+            jclass fieldClass = buildClasses[field.fieldClass];
+            jfieldID fieldID = buildFieldIds[index];
+            if (!fieldClass || !fieldID) {
+                LOGD("字段 %s 不存在或无法修改", fieldName);
+                continue;
+            }
+
+            setField(fieldClass, fieldID, field);
 
-            fieldID = env->GetStaticFieldID(buildClass, fieldName, "Ljava/lang/String;");
+            jniCalls++;
             if (env->ExceptionCheck()) {
                 env->ExceptionClear();
-                fieldID = env->GetStaticFieldID(versionClass, fieldName, "Ljava/lang/String;");
-                
-                if (env->ExceptionCheck()) {
-                    env->ExceptionClear();
-                    fieldID = env->GetStaticFieldID(versionClass, fieldName, "I");
-                    if (!env->ExceptionCheck() && fieldID != nullptr) {
-                        isStringField = false;
-                    } else {
-                        env->ExceptionClear();
-                        LOGD("字段 %s 不存在或无法修改", fieldName);
-                        continue;
-                    }
-                }
+                LOGW("设置字段 '%s' 时发生异常", fieldName);
             }
+        }
 
-            if (fieldID != nullptr) {
-                if (isStringField) {
-                    jstring jValue = env->NewStringUTF(val.c_str());
-                    if (env->IsSameObject(buildClass, versionClass)) {
-                        env->SetStaticObjectField(versionClass, fieldID, jValue);
-                    } else {
-                        env->SetStaticObjectField(buildClass, fieldID, jValue);
-                    }
-                    env->DeleteLocalRef(jValue);
-                    LOGD("已设置 '%s' 为 '%s'", fieldName, val.c_str());
-                } else {
-                    int intValue = std::stoi(val);
-                    env->SetStaticIntField(versionClass, fieldID, intValue);
-                    LOGD("已设置 '%s' 为 '%d'", fieldName, intValue);
-                }
+        LOGD("UpdateBuildFields 处理完成");
+    }
+
+    // 设置默认 Locale 与 LocaleList.
+    // 系统 Resources 的配置不在这里修改: bindApplication 会以 system_server 下发的配置整体替换它.
+    // 标签已由 Companion 拆分与规范化, 这里只做构造与设置, 局部引用由 PopLocalFrame 一次释放
+    void applyLocale(const ProfilePayload::Locale &spoofLocale) {
+        LOGD("设置语言: %s", spoofLocale.tag);
+        if (env->PushLocalFrame(16) != 0) {
+            env->ExceptionClear();
+            LOGE("无法分配局部引用帧");
+            return;
+        }
+        jniCalls++;
+        if (!setDefaultLocale(spoofLocale)) {
+            LOGW("设置语言 %s 时发生异常", spoofLocale.tag);
+            env->ExceptionClear();
+        }
+        env->PopLocalFrame(nullptr);
+        jniCalls += 2;
+    }
 
-                if (env->ExceptionCheck()) {
-                    env->ExceptionClear();
-                    LOGW("设置字段 '%s' 时发生异常", fieldName);
-                    continue;
+    // 可能抛出异常的调用之后都要检查, 有未处理异常时不能再发出其他 JNI 调用
+    bool failed(const void *result) {
+        jniCalls++;
+        return !result || env->ExceptionCheck();
+    }
+
+    jstring newLocaleString(const char *text) {
+        jstring string = env->NewStringUTF(text);
+        jniCalls++;
+        return failed(string) ? nullptr : string;
+    }
+
+    bool setDefaultLocale(const ProfilePayload::Locale &spoofLocale) {
+        jclass localeClass = env->FindClass("java/util/Locale");
+        jniCalls++;
+        if (!localeClass) {
+            return false;
+        }
+
+        // 常见的 language[-region] 直接构造; 带 script 的标签 Locale 构造函数无法表达, 交给 forLanguageTag
+        jobject locale;
+        if (spoofLocale.script[0] == '\0') {
+            jmethodID constructor = env->GetMethodID(localeClass, "<init>",
+                                                     "(Ljava/lang/String;Ljava/lang/String;Ljava/lang/String;)V");
+            jniCalls++;
+            if (!constructor) {
+                return false;
+            }
+            jstring language = newLocaleString(spoofLocale.language);
+            if (!language) {
+                return false;
+            }
+            jstring region = newLocaleString(spoofLocale.region);
+            if (!region) {
+                return false;
+            }
+            jstring variant = newLocaleString(spoofLocale.variant);
+            if (!variant) {
+                return false;
+            }
+            locale = env->NewObject(localeClass, constructor, language, region, variant);
+            jniCalls++;
+        } else {
+            jmethodID forLanguageTag = env->GetStaticMethodID(localeClass, "forLanguageTag",
+                                                              "(Ljava/lang/String;)Ljava/util/Locale;");
+            jniCalls++;
+            if (!forLanguageTag) {
+                return false;
+            }
+            jstring tag = newLocaleString(spoofLocale.tag);
+            if (!tag) {
+                return false;
+            }
+            locale = env->CallStaticObjectMethod(localeClass, forLanguageTag, tag);
+            jniCalls++;
+        }
+        if (failed(locale)) {
+            return false;
+        }
+
+        jmethodID setDefault = env->GetStaticMethodID(localeClass, "setDefault", "(Ljava/util/Locale;)V");
+        jniCalls++;
+        if (!setDefault) {
+            return false;
+        }
+        env->CallStaticVoidMethod(localeClass, setDefault, locale);
+        jniCalls += 2;
+        if (env->ExceptionCheck()) {
+            return false;
+        }
+
+        jclass localeListClass = env->FindClass("android/os/LocaleList");
+        jniCalls++;
+        if (!localeListClass) {
+            return false;
+        }
+        jmethodID listConstructor = env->GetMethodID(localeListClass, "<init>", "([Ljava/util/Locale;)V");
+        jniCalls++;
+        if (!listConstructor) {
+            return false;
+        }
+        jmethodID setDefaultList = env->GetStaticMethodID(localeListClass, "setDefault", "(Landroid/os/LocaleList;)V");
+        jniCalls++;
+        if (!setDefaultList) {
+            return false;
+        }
+        jobjectArray locales = env->NewObjectArray(1, localeClass, locale);
+        jniCalls++;
+        if (failed(locales)) {
+            return false;
+        }
+        jobject localeList = env->NewObject(localeListClass, listConstructor, locales);
+        jniCalls++;
+        if (failed(localeList)) {
+            return false;
+        }
+        env->CallStaticVoidMethod(localeListClass, setDefaultList, localeList);
+        jniCalls += 2;
+        return !env->ExceptionCheck();
+    }
+
+    void setField(jclass fieldClass, jfieldID fieldID, const ProfilePayload::Field &field) {
+        [[maybe_unused]] const char *fieldName = field.name.data();
+        switch (field.type) {
+            case BuildFields::TYPE_INT:
+                env->SetStaticIntField(fieldClass, fieldID, static_cast<jint>(field.intValue));
+                jniCalls++;
+                LOGD("已设置 '%s' 为 '%lld'", fieldName, static_cast<long long>(field.intValue));
+                break;
+            case BuildFields::TYPE_LONG:
+                env->SetStaticLongField(fieldClass, fieldID, field.intValue);
+                jniCalls++;
+                LOGD("已设置 '%s' 为 '%lld'", fieldName, static_cast<long long>(field.intValue));
+                break;
+            case BuildFields::TYPE_BOOLEAN:
+                env->SetStaticBooleanField(fieldClass, fieldID, field.intValue ? JNI_TRUE : JNI_FALSE);
+                jniCalls++;
+                LOGD("已设置 '%s' 为 '%s'", fieldName, field.intValue ? "true" : "false");
+                break;
+            case BuildFields::TYPE_STRING_ARRAY: {
+                jobjectArray jArray = newStringArray(field);
+                if (jArray) {
+                    env->SetStaticObjectField(fieldClass, fieldID, jArray);
+                    env->DeleteLocalRef(jArray);
+                    jniCalls += 2;
+                    LOGD("已设置 '%s' 为 %u 个元素的数组", fieldName, field.elementCount);
                 }
+                break;
+            }
+            case BuildFields::TYPE_STRING:
+            default: {
+                jstring jValue = env->NewStringUTF(field.value);
+                env->SetStaticObjectField(fieldClass, fieldID, jValue);
+                env->DeleteLocalRef(jValue);
+                jniCalls += 3;
+                LOGD("已设置 '%s' 为 '%s'", fieldName, field.value);
+                break;
             }
         }
+    }
 
-        env->DeleteLocalRef(buildClass);
-        env->DeleteLocalRef(versionClass);
-        LOGD("UpdateBuildFields 处理完成");
+    // 元素在记录中以 '\0' 分隔依次存放, 每个字段只构建一次数组
+    jobjectArray newStringArray(const ProfilePayload::Field &field) {
+        if (!stringClass) {
+            stringClass = env->FindClass("java/lang/String");
+            jniCalls++;
+            if (!stringClass) {
+                env->ExceptionClear();
+                LOGE("无法找到类 java/lang/String");
+                return nullptr;
+            }
+        }
+        jobjectArray jArray = env->NewObjectArray(field.elementCount, stringClass, nullptr);
+        jniCalls++;
+        if (!jArray) {
+            env->ExceptionClear();
+            return nullptr;
+        }
+        const char *element = field.value;
+        for (uint16_t i = 0; i < field.elementCount; i++, element = ProfilePayload::nextElement(element)) {
+            jstring jElement = env->NewStringUTF(element);
+            env->SetObjectArrayElement(jArray, i, jElement);
+            env->DeleteLocalRef(jElement);
+            jniCalls += 3;
+        }
+        return jArray;
     }
 };
 
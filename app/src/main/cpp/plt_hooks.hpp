@@ -0,0 +1,126 @@
+#ifndef PLT_HOOKS_HPP
+#define PLT_HOOKS_HPP
+
+#include "utils.hpp"
+#include "zygisk.hpp"
+
+#include <climits>
+#include <sys/sysmacros.h>
+
+// app 进程中全部 PLT hook 的注册与提交. 各功能在 specialize 时用 add 登记要替换的符号,
+// 最后由 commit 对已加载的 ELF 一次性注册并提交.
+//
+// PLT hook 只作用于 preAppSpecialize 时已加载的 ELF. Zygisk 在 specialize 结束后卸载,
+// Api 的函数表随之失效, 之后经 System.loadLibrary 加载的库 (含 app 自带的 native 库) 不在覆盖范围内.
+// 这一限制写在 README 中, 需要覆盖这些库的属性应使用 "propsMode": "overlay".
+//
+// hook 函数只能访问全局状态. 本文件及各 hook 模块的全局变量均为常量初始化, 不会在 app 进程中产生静态构造.
+namespace PltHooks {
+
+struct Hook {
+    const char* symbol;
+    void* replacement;
+    void** original;
+};
+
+inline zygisk::Api* api = nullptr;
+
+constexpr size_t MAX_HOOKS = 32;
+inline Hook hooks[MAX_HOOKS];
+inline size_t hookCount = 0;
+
+struct LoadedElf {
+    dev_t dev;
+    ino_t inode;
+};
+constexpr size_t MAX_HOOKED_ELVES = 1024;
+inline LoadedElf hookedElves[MAX_HOOKED_ELVES];
+inline size_t hookedElfCount = 0;
+
+// 登记一个要替换的符号; 只能在 commit 之前调用
+inline void add(const char* symbol, void* replacement, void** original) {
+    if (hookCount == MAX_HOOKS) {
+        LOGE("PLT hook 数量达到上限，忽略: %s", symbol);
+        return;
+    }
+    hooks[hookCount++] = {symbol, replacement, original};
+}
+
+inline bool isHooked(dev_t dev, ino_t inode) {
+    for (size_t i = 0; i < hookedElfCount; i++) {
+        if (hookedElves[i].dev == dev && hookedElves[i].inode == inode) {
+            return true;
+        }
+    }
+    return false;
+}
+
+inline bool shouldHook(std::string_view path) {
+    if (path.size() > 3 && path.substr(path.size() - 3) == ".so") {
+        // libc 内部直接调用这些函数, 没有经过自身的 PLT
+        return path.substr(path.rfind('/') + 1) != "libc.so";
+    }
+    return path.find("/app_process") != std::string_view::npos;
+}
+
+// 为 /proc/self/maps 中的 ELF 注册全部 hook, 返回是否有注册
+inline bool registerLoadedElves() {
+    // stdio 会为 FILE 与读缓冲区分配堆内存, spawn 路径上改用 LineReader
+    LineReader maps("/proc/self/maps");
+    if (!maps.valid()) {
+        LOGE("无法读取 /proc/self/maps: %s", strerror(errno));
+        return false;
+    }
+
+    bool registered = false;
+    char line[PATH_MAX + 128];
+    while (maps.next(line, sizeof(line))) {
+        unsigned long offset = 0;
+        unsigned long inode = 0;
+        unsigned int major = 0;
+        unsigned int minor = 0;
+        int pathStart = 0;
+        if (sscanf(line, "%*x-%*x %*s %lx %x:%x %lu %n", &offset, &major, &minor, &inode, &pathStart) != 4 ||
+            offset != 0 || inode == 0 || pathStart == 0) {
+            continue;
+        }
+        std::string_view path(line + pathStart);
+        while (!path.empty() && path.back() == ' ') {
+            path.remove_suffix(1);
+        }
+        dev_t dev = makedev(major, minor);
+        if (!shouldHook(path) || isHooked(dev, inode)) {
+            continue;
+        }
+        if (hookedElfCount == MAX_HOOKED_ELVES) {
+            LOGW("已注册的 ELF 数量达到上限，忽略: %.*s", static_cast<int>(path.size()), path.data());
+            break;
+        }
+        hookedElves[hookedElfCount++] = {dev, static_cast<ino_t>(inode)};
+
+        for (size_t i = 0; i < hookCount; i++) {
+            api->pltHookRegister(dev, inode, hooks[i].symbol, hooks[i].replacement, hooks[i].original);
+        }
+        registered = true;
+    }
+    return registered;
+}
+
+// 为已加载的 ELF 注册登记过的全部 hook 并提交; 只能在 preAppSpecialize 中调用.
+// 返回 true 表示 hook 可能已生效, 模块必须常驻
+inline bool commit(zygisk::Api* zygiskApi) {
+    if (hookCount == 0) {
+        return false;
+    }
+    api = zygiskApi;
+    bool registered = registerLoadedElves();
+    if (registered && !api->pltHookCommit()) {
+        LOGE("提交 PLT hook 失败");
+    }
+    LOGD("已为 %zu 个 ELF 注册 %zu 个 PLT hook", hookedElfCount, hookCount);
+    return registered;
+}
+
+} // namespace PltHooks
+
+#endif // PLT_HOOKS_HPP
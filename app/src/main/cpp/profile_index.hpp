@@ -0,0 +1,398 @@
+#ifndef PROFILE_INDEX_HPP
+#define PROFILE_INDEX_HPP
+
+#include "utils.hpp"
+#include "build_fields.hpp"
+
+#include <string_view>
+
+// config.json 编译后的二进制索引格式, 可直接 mmap 使用:
+//
+//   Header | 字符串池 | TargetEntry[] | 哈希桶 uint32_t[] | TrieNode[] | TrieEdge[] |
+//   ProfileRecord[] | FieldRecord[] | 响应数据
+//
+// 所有偏移均相对于文件起始位置, 字符串池中的字符串均以 '\0' 结尾.
+//
+// targets 支持三种写法:
+//   "com.vendor.app"  精确匹配, 存于哈希表
+//   "com.vendor.*"    前缀匹配, 存于前缀 trie
+//   "*:remote"        后缀匹配, 逆序存于后缀 trie
+// 匹配优先级: 精确匹配 > 字面部分更长的模式 > 同长度时前缀模式优先.
+// 查询耗时只与进程名长度有关, 与模式数量无关.
+namespace ProfileIndex {
+
+constexpr uint32_t INDEX_MAGIC = 0x58494446; // "FDIX"
+constexpr uint16_t INDEX_VERSION = 13;
+
+enum IndexFlag : uint32_t {
+    // 只含 targets 与匹配结构, 不含 build 字段与响应数据; 发布到模块目录供 app 进程本地预筛
+    INDEX_FLAG_TARGETS_ONLY = 1u << 0,
+};
+
+struct StringRef {
+    uint32_t offset; // 相对于字符串池
+    uint32_t length; // 不含结尾的 '\0'
+};
+
+struct Header {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t headerSize;
+    uint32_t fileSize;
+    uint32_t flags;
+    int64_t sourceWriteTime; // 编译时 config.json 的修改时间
+    uint32_t stringPoolOffset;
+    uint32_t stringPoolSize;
+    uint32_t targetCount;
+    uint32_t targetOffset;
+    uint32_t bucketCount;    // 2 的幂, 线性探测
+    uint32_t bucketOffset;   // 0 表示空桶, 否则为 target 下标 + 1
+    uint32_t nodeCount;      // 节点 0 为前缀 trie 根, 节点 1 为后缀 trie 根
+    uint32_t nodeOffset;
+    uint32_t edgeCount;
+    uint32_t edgeOffset;
+    uint32_t profileCount;
+    uint32_t profileOffset;
+    uint32_t fieldCount;
+    uint32_t fieldOffset;
+    uint32_t responseOffset;
+    uint32_t responseSize;
+};
+
+struct TargetEntry {
+    uint32_t hash;
+    uint32_t profileIndex;
+    StringRef name;
+};
+
+struct TrieNode {
+    uint32_t firstEdge;
+    uint32_t edgeCount;  // 子边按字符升序连续存放
+    uint32_t profile;    // 0 表示此处没有模式结束, 否则为 profile 下标 + 1
+};
+
+struct TrieEdge {
+    uint8_t ch;
+    uint8_t reserved[3];
+    uint32_t node;
+};
+
+constexpr uint32_t PREFIX_TRIE_ROOT = 0;
+constexpr uint32_t SUFFIX_TRIE_ROOT = 1;
+
+struct ProfileRecord {
+    StringRef name;
+    uint32_t firstField;
+    uint32_t fieldCount;
+    uint32_t responseOffset; // 预先组帧的完整响应 (Protocol::ResponseHeader + 数据)
+    uint32_t responseSize;
+};
+
+// 加载配置时已完成分类的 Build 字段
+struct FieldRecord {
+    StringRef key;
+    StringRef value;
+    uint8_t fieldClass; // BuildFields::FieldClass
+    uint8_t fieldType;  // BuildFields::FieldType
+    uint16_t elementCount; // TYPE_STRING_ARRAY 的元素个数, 各元素在 value 中以 '\0' 分隔
+    uint32_t reserved;
+    int64_t intValue;   // TYPE_INT / TYPE_LONG / TYPE_BOOLEAN 字段预先解析的值
+};
+
+constexpr uint32_t hashName(std::string_view name) {
+    uint32_t hash = 2166136261u;
+    for (char c : name) {
+        hash ^= static_cast<uint8_t>(c);
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// 只读视图, 不拥有内存
+class View {
+public:
+    View() = default;
+
+    bool attach(const uint8_t* data, size_t size) {
+        base = nullptr;
+        if (size < sizeof(Header)) {
+            return false;
+        }
+        const auto* hdr = reinterpret_cast<const Header*>(data);
+        if (hdr->magic != INDEX_MAGIC || hdr->version != INDEX_VERSION ||
+            hdr->headerSize != sizeof(Header) || hdr->fileSize != size) {
+            return false;
+        }
+        if (hdr->bucketCount == 0 || (hdr->bucketCount & (hdr->bucketCount - 1)) != 0 ||
+            hdr->bucketCount < hdr->targetCount || hdr->nodeCount < 2) {
+            return false;
+        }
+        if (!inRange(hdr, hdr->stringPoolOffset, hdr->stringPoolSize, 1) ||
+            !inRange(hdr, hdr->targetOffset, hdr->targetCount, sizeof(TargetEntry)) ||
+            !inRange(hdr, hdr->bucketOffset, hdr->bucketCount, sizeof(uint32_t)) ||
+            !inRange(hdr, hdr->nodeOffset, hdr->nodeCount, sizeof(TrieNode)) ||
+            !inRange(hdr, hdr->edgeOffset, hdr->edgeCount, sizeof(TrieEdge)) ||
+            !inRange(hdr, hdr->profileOffset, hdr->profileCount, sizeof(ProfileRecord)) ||
+            !inRange(hdr, hdr->fieldOffset, hdr->fieldCount, sizeof(FieldRecord)) ||
+            !inRange(hdr, hdr->responseOffset, hdr->responseSize, 1)) {
+            return false;
+        }
+
+        base = data;
+        for (uint32_t i = 0; i < hdr->targetCount; i++) {
+            const TargetEntry& target = targets()[i];
+            if (target.profileIndex >= hdr->profileCount || !validString(target.name)) {
+                base = nullptr;
+                return false;
+            }
+        }
+        for (uint32_t i = 0; i < hdr->bucketCount; i++) {
+            if (buckets()[i] > hdr->targetCount) {
+                base = nullptr;
+                return false;
+            }
+        }
+        for (uint32_t i = 0; i < hdr->nodeCount; i++) {
+            const TrieNode& node = nodes()[i];
+            if (node.profile > hdr->profileCount ||
+                node.firstEdge > hdr->edgeCount || node.edgeCount > hdr->edgeCount - node.firstEdge) {
+                base = nullptr;
+                return false;
+            }
+        }
+        for (uint32_t i = 0; i < hdr->edgeCount; i++) {
+            // child() 以 0 表示不存在, 根节点不能作为子节点
+            if (edges()[i].node >= hdr->nodeCount || edges()[i].node < 2) {
+                base = nullptr;
+                return false;
+            }
+        }
+        for (uint32_t i = 0; i < hdr->profileCount; i++) {
+            const ProfileRecord& profile = profiles()[i];
+            if (!validString(profile.name) ||
+                profile.firstField > hdr->fieldCount ||
+                profile.fieldCount > hdr->fieldCount - profile.firstField ||
+                profile.responseOffset > hdr->responseSize ||
+                profile.responseSize > hdr->responseSize - profile.responseOffset) {
+                base = nullptr;
+                return false;
+            }
+        }
+        for (uint32_t i = 0; i < hdr->fieldCount; i++) {
+            const FieldRecord& field = fields()[i];
+            if (!validString(field.key) || !validString(field.value) ||
+                field.fieldClass >= BuildFields::CLASS_COUNT || field.fieldType >= BuildFields::TYPE_COUNT) {
+                base = nullptr;
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool valid() const { return base != nullptr; }
+    const Header& header() const { return *reinterpret_cast<const Header*>(base); }
+
+    std::string_view string(StringRef ref) const {
+        return {reinterpret_cast<const char*>(base + header().stringPoolOffset + ref.offset), ref.length};
+    }
+
+    const ProfileRecord* findProfile(std::string_view name) const {
+        if (!base) {
+            return nullptr;
+        }
+        if (const ProfileRecord* exact = findExact(name)) {
+            return exact;
+        }
+
+        uint32_t prefixProfile = 0;
+        size_t prefixLength = 0;
+        uint32_t node = PREFIX_TRIE_ROOT;
+        for (size_t i = 0;; i++) {
+            if (nodes()[node].profile != 0) {
+                prefixProfile = nodes()[node].profile;
+                prefixLength = i;
+            }
+            if (i == name.size() || (node = child(node, name[i])) == 0) {
+                break;
+            }
+        }
+
+        uint32_t suffixProfile = 0;
+        size_t suffixLength = 0;
+        node = SUFFIX_TRIE_ROOT;
+        for (size_t i = 0;; i++) {
+            if (nodes()[node].profile != 0) {
+                suffixProfile = nodes()[node].profile;
+                suffixLength = i;
+            }
+            if (i == name.size() || (node = child(node, name[name.size() - 1 - i])) == 0) {
+                break;
+            }
+        }
+
+        uint32_t matched = (suffixProfile != 0 && (prefixProfile == 0 || suffixLength > prefixLength))
+                           ? suffixProfile : prefixProfile;
+        return matched != 0 ? &profiles()[matched - 1] : nullptr;
+    }
+
+    uint32_t profileCount() const { return base ? header().profileCount : 0; }
+
+    const ProfileRecord& profile(uint32_t index) const { return profiles()[index]; }
+
+    uint32_t profileIndexOf(const ProfileRecord& profile) const {
+        return static_cast<uint32_t>(&profile - profiles());
+    }
+
+    const FieldRecord* profileFields(const ProfileRecord& profile) const {
+        return fields() + profile.firstField;
+    }
+
+    const uint8_t* response(const ProfileRecord& profile) const {
+        return base + responseFileOffset(profile);
+    }
+
+    uint32_t responseFileOffset(const ProfileRecord& profile) const {
+        return header().responseOffset + profile.responseOffset;
+    }
+
+private:
+    const uint8_t* base = nullptr;
+
+    const ProfileRecord* findExact(std::string_view name) const {
+        if (header().targetCount == 0) {
+            return nullptr;
+        }
+        uint32_t hash = hashName(name);
+        uint32_t mask = header().bucketCount - 1;
+        for (uint32_t i = 0; i <= mask; i++) {
+            uint32_t slot = buckets()[(hash + i) & mask];
+            if (slot == 0) {
+                return nullptr;
+            }
+            const TargetEntry& target = targets()[slot - 1];
+            if (target.hash == hash && string(target.name) == name) {
+                return &profiles()[target.profileIndex];
+            }
+        }
+        return nullptr;
+    }
+
+    // 返回 0 表示没有对应子节点 (根节点不会作为子节点出现)
+    uint32_t child(uint32_t node, char c) const {
+        const TrieNode& parent = nodes()[node];
+        const TrieEdge* first = edges() + parent.firstEdge;
+        const TrieEdge* last = first + parent.edgeCount;
+        auto ch = static_cast<uint8_t>(c);
+        while (first < last) {
+            const TrieEdge* mid = first + (last - first) / 2;
+            if (mid->ch < ch) {
+                first = mid + 1;
+            } else {
+                last = mid;
+            }
+        }
+        return (first != edges() + parent.firstEdge + parent.edgeCount && first->ch == ch) ? first->node : 0;
+    }
+
+    static bool inRange(const Header* hdr, uint32_t offset, uint32_t count, size_t elementSize) {
+        return offset <= hdr->fileSize &&
+               static_cast<uint64_t>(count) * elementSize <= hdr->fileSize - offset;
+    }
+
+    bool validString(StringRef ref) const {
+        return ref.offset < header().stringPoolSize &&
+               ref.length < header().stringPoolSize - ref.offset &&
+               base[header().stringPoolOffset + ref.offset + ref.length] == '\0';
+    }
+
+    const TargetEntry* targets() const {
+        return reinterpret_cast<const TargetEntry*>(base + header().targetOffset);
+    }
+    const uint32_t* buckets() const {
+        return reinterpret_cast<const uint32_t*>(base + header().bucketOffset);
+    }
+    const TrieNode* nodes() const {
+        return reinterpret_cast<const TrieNode*>(base + header().nodeOffset);
+    }
+    const TrieEdge* edges() const {
+        return reinterpret_cast<const TrieEdge*>(base + header().edgeOffset);
+    }
+    const ProfileRecord* profiles() const {
+        return reinterpret_cast<const ProfileRecord*>(base + header().profileOffset);
+    }
+    const FieldRecord* fields() const {
+        return reinterpret_cast<const FieldRecord*>(base + header().fieldOffset);
+    }
+};
+
+// 以只读共享方式映射索引文件, 生命周期内保持映射
+class MappedFile {
+public:
+    MappedFile() = default;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    ~MappedFile() {
+        if (data) {
+            munmap(data, size);
+        }
+        if (ownedFd >= 0) {
+            close(ownedFd);
+        }
+    }
+
+    bool map(const char* path) {
+        int fd = open(path, O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            return false;
+        }
+        bool ok = mapFd(fd);
+        close(fd);
+        return ok;
+    }
+
+    bool mapFd(int fd) {
+        struct stat st{};
+        if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+            return false;
+        }
+        void* addr = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        if (addr == MAP_FAILED) {
+            return false;
+        }
+        data = addr;
+        size = st.st_size;
+        if (!index.attach(static_cast<const uint8_t*>(data), size)) {
+            munmap(data, size);
+            data = nullptr;
+            size = 0;
+            return false;
+        }
+        return true;
+    }
+
+    // 映射并接管 fd (例如需要转发给其他进程的密封 memfd)
+    bool adoptFd(int fd) {
+        if (!mapFd(fd)) {
+            close(fd);
+            return false;
+        }
+        ownedFd = fd;
+        return true;
+    }
+
+    const View& view() const { return index; }
+    const uint8_t* bytes() const { return static_cast<const uint8_t*>(data); }
+    size_t byteSize() const { return size; }
+    int fd() const { return ownedFd; }
+
+private:
+    int ownedFd = -1;
+    void* data = nullptr;
+    size_t size = 0;
+    View index;
+};
+
+} // namespace ProfileIndex
+
+#endif // PROFILE_INDEX_HPP
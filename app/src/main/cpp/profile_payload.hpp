@@ -0,0 +1,426 @@
+#ifndef PROFILE_PAYLOAD_HPP
+#define PROFILE_PAYLOAD_HPP
+
+#include "build_fields.hpp"
+
+#include <sys/system_properties.h>
+#include <sys/utsname.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+// Companion 发给 app 进程的单个配置记录, app 进程直接在接收缓冲区或共享映射中遍历:
+//
+//   PayloadHeader | PayloadField[fieldCount] | 属性哈希桶 | 属性条目 | 文件哈希桶 | 文件条目 | 字符串区
+//
+// 偏移均相对于记录起始位置, 字符串均以 '\0' 结尾, 可直接交给 JNI 使用.
+// 记录起始位置按 8 字节对齐.
+//
+// 属性条目与 bionic 的 prop_info 布局一致 (serial | value[PROP_VALUE_MAX] | name),
+// 可直接作为 prop_info 指针交给调用方, 即使被未 hook 的 libc 函数读取也能得到正确结果.
+// 虚拟文件的路径与内容均存放在字符串区, 内容由 Companion 预先生成.
+namespace ProfilePayload {
+
+constexpr uint32_t PAYLOAD_MAGIC = 0x52504446; // "FDPR"
+constexpr uint16_t PAYLOAD_VERSION = 7;
+
+enum PayloadFlag : uint32_t {
+    // props 优先通过属性区覆盖生效 (见 property_area.hpp), 未能覆盖的部分仍由 hook 提供
+    PAYLOAD_FLAG_PROPERTY_OVERLAY = 1u << 0,
+};
+
+struct PayloadString {
+    uint32_t offset;
+    uint32_t length; // 不含结尾的 '\0'
+};
+
+// 预先拆分的语言标签, language 为空表示不伪装语言
+struct PayloadLocale {
+    PayloadString tag;
+    PayloadString language;
+    PayloadString script;
+    PayloadString region;
+    PayloadString variant;
+};
+
+// 开放寻址哈希表, 线性探测; 桶为 8 字节, 一条缓存行容纳 8 个桶, 负载不超过 1/2,
+// 未覆盖的属性通常只需一次探测即可确认
+struct PayloadPropertyTable {
+    uint32_t bucketCount; // 0 或 2 的幂
+    uint32_t bucketOffset;
+    uint32_t entryOffset;
+    uint32_t entrySize;
+    uint32_t count;
+    uint32_t reserved;
+};
+
+struct PropertyBucket {
+    uint32_t hash;
+    uint32_t entry; // 0 表示空桶, 否则为 PropertyEntry 相对于记录起始位置的偏移
+};
+
+struct PropertyEntry {
+    uint32_t serial; // 高 8 位为取值长度, 与 prop_info 一致
+    char value[PROP_VALUE_MAX];
+    // 紧随其后为以 '\0' 结尾的属性名
+};
+static_assert(sizeof(PropertyEntry) == 96, "PropertyEntry must match the prop_info layout");
+
+// uname 中要替换的字段, 空串表示保留真实值; 长度均小于 utsname 的字段长度
+struct PayloadKernel {
+    PayloadString sysname;
+    PayloadString release;
+    PayloadString version;
+    PayloadString machine;
+};
+
+// 与属性表相同的开放寻址哈希表, 桶指向 FileEntry; 未虚拟化的路径通常一次探测即可放行
+struct PayloadFileTable {
+    uint32_t bucketCount; // 0 或 2 的幂
+    uint32_t bucketOffset;
+    uint32_t entryOffset;
+    uint32_t count;
+};
+
+struct FileEntry {
+    PayloadString path;
+    PayloadString content;
+};
+
+struct PayloadHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t fieldCount;
+    uint32_t flags; // PayloadFlag
+    uint32_t reserved;
+    PayloadString name;
+    PayloadLocale locale;
+    PayloadPropertyTable properties;
+    PayloadFileTable files;
+    PayloadKernel kernel;
+};
+
+struct PayloadField {
+    uint8_t fieldClass; // BuildFields::FieldClass
+    uint8_t fieldType;  // BuildFields::FieldType
+    uint16_t elementCount; // TYPE_STRING_ARRAY 的元素个数
+    uint32_t reserved;
+    int64_t intValue;   // TYPE_INT / TYPE_LONG / TYPE_BOOLEAN 字段预先解析的值
+    PayloadString name;
+    PayloadString value; // TYPE_STRING_ARRAY 的各元素依次存放, 以 '\0' 分隔
+};
+
+struct Field {
+    BuildFields::FieldClass fieldClass;
+    BuildFields::FieldType type;
+    std::string_view name;
+    const char* value; // 以 '\0' 结尾; 数组为首个元素
+    int64_t intValue;
+    uint16_t elementCount;
+};
+
+struct Kernel {
+    const char* sysname;
+    const char* release;
+    const char* version;
+    const char* machine;
+};
+
+struct Locale {
+    const char* tag;
+    const char* language;
+    const char* script;
+    const char* region;
+    const char* variant;
+};
+
+// 属性名与文件路径共用的 FNV-1a 哈希
+constexpr uint32_t hashKey(const char* name) {
+    uint32_t hash = 2166136261u;
+    for (; *name; name++) {
+        hash ^= static_cast<uint8_t>(*name);
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+inline const char* propertyName(const PropertyEntry* entry) {
+    return reinterpret_cast<const char*>(entry + 1);
+}
+
+inline uint32_t propertyValueLength(const PropertyEntry* entry) {
+    return entry->serial >> 24;
+}
+
+// 遍历 TYPE_STRING_ARRAY 的元素, attach 时已确认元素个数与分隔符一致
+inline const char* nextElement(const char* element) {
+    return element + strlen(element) + 1;
+}
+
+// 只读视图, 不拥有内存; attach 时完成全部校验, 之后的访问不再检查边界
+class View {
+public:
+    View() = default;
+
+    bool attach(const uint8_t* data, size_t size) {
+        base = nullptr;
+        if (size < sizeof(PayloadHeader) || reinterpret_cast<uintptr_t>(data) % alignof(PayloadHeader) != 0) {
+            return false;
+        }
+        const auto* hdr = reinterpret_cast<const PayloadHeader*>(data);
+        if (hdr->magic != PAYLOAD_MAGIC || hdr->version != PAYLOAD_VERSION ||
+            (size - sizeof(PayloadHeader)) / sizeof(PayloadField) < hdr->fieldCount ||
+            !validString(data, size, hdr->name) || !validString(data, size, hdr->locale.tag) ||
+            !validString(data, size, hdr->locale.language) || !validString(data, size, hdr->locale.script) ||
+            !validString(data, size, hdr->locale.region) || !validString(data, size, hdr->locale.variant)) {
+            return false;
+        }
+
+        if (!validProperties(data, size, hdr->properties) || !validFiles(data, size, hdr->files) ||
+            !validKernelString(data, size, hdr->kernel.sysname) || !validKernelString(data, size, hdr->kernel.release) ||
+            !validKernelString(data, size, hdr->kernel.version) || !validKernelString(data, size, hdr->kernel.machine)) {
+            return false;
+        }
+
+        const auto* records = reinterpret_cast<const PayloadField*>(data + sizeof(PayloadHeader));
+        for (uint16_t i = 0; i < hdr->fieldCount; i++) {
+            const PayloadField& record = records[i];
+            if (record.fieldClass >= BuildFields::CLASS_COUNT || record.fieldType >= BuildFields::TYPE_COUNT ||
+                !validString(data, size, record.name) || !validString(data, size, record.value) ||
+                !validElements(data, record)) {
+                return false;
+            }
+        }
+
+        base = data;
+        byteSize = size;
+        return true;
+    }
+
+    explicit operator bool() const { return base != nullptr; }
+
+    const uint8_t* data() const { return base; }
+    size_t size() const { return byteSize; }
+
+    std::string_view name() const { return string(header().name); }
+
+    size_t fieldCount() const { return base ? header().fieldCount : 0; }
+
+    size_t propertyCount() const { return base ? header().properties.count : 0; }
+
+    const PropertyEntry* findProperty(const char* name) const {
+        int bucket = findPropertyBucket(name);
+        return bucket >= 0 ? propertyAt(static_cast<uint32_t>(bucket)) : nullptr;
+    }
+
+    // 返回属性所在的桶下标, 未覆盖时返回 -1; 可用于索引与桶一一对应的附加数据
+    int findPropertyBucket(const char* name) const {
+        const PayloadPropertyTable& table = header().properties;
+        if (table.bucketCount == 0) {
+            return -1;
+        }
+        uint32_t hash = hashKey(name);
+        const PropertyBucket* buckets = propertyBuckets();
+        for (uint32_t slot = hash & (table.bucketCount - 1);; slot = (slot + 1) & (table.bucketCount - 1)) {
+            const PropertyBucket& bucket = buckets[slot];
+            if (bucket.entry == 0) {
+                return -1;
+            }
+            if (bucket.hash == hash && strcmp(propertyName(propertyAt(slot)), name) == 0) {
+                return static_cast<int>(slot);
+            }
+        }
+    }
+
+    uint32_t propertyBucketCount() const { return base ? header().properties.bucketCount : 0; }
+
+    // 空桶返回 nullptr
+    const PropertyEntry* propertyAt(uint32_t bucket) const {
+        uint32_t offset = propertyBuckets()[bucket].entry;
+        return offset ? reinterpret_cast<const PropertyEntry*>(base + offset) : nullptr;
+    }
+
+    // 判断 prop_info 指针是否指向本记录中的条目
+    bool ownsProperty(const void* pi) const {
+        const PayloadPropertyTable& table = header().properties;
+        const auto* p = static_cast<const uint8_t*>(pi);
+        return p >= base + table.entryOffset && p < base + table.entryOffset + table.entrySize;
+    }
+
+    size_t fileCount() const { return base ? header().files.count : 0; }
+
+    // 按绝对路径查找虚拟文件, 未虚拟化时返回 nullptr
+    const FileEntry* findFile(const char* path) const {
+        const PayloadFileTable& table = header().files;
+        if (table.bucketCount == 0) {
+            return nullptr;
+        }
+        uint32_t hash = hashKey(path);
+        const PropertyBucket* buckets = reinterpret_cast<const PropertyBucket*>(base + table.bucketOffset);
+        for (uint32_t slot = hash & (table.bucketCount - 1);; slot = (slot + 1) & (table.bucketCount - 1)) {
+            const PropertyBucket& bucket = buckets[slot];
+            if (bucket.entry == 0) {
+                return nullptr;
+            }
+            const auto* entry = reinterpret_cast<const FileEntry*>(base + bucket.entry);
+            if (bucket.hash == hash && strcmp(cString(entry->path), path) == 0) {
+                return entry;
+            }
+        }
+    }
+
+    std::string_view fileContent(const FileEntry& entry) const { return string(entry.content); }
+
+    // 按下标访问虚拟文件, 下标与 fileIndex 一致
+    const FileEntry& fileAt(size_t index) const { return fileEntries()[index]; }
+    size_t fileIndex(const FileEntry& entry) const { return static_cast<size_t>(&entry - fileEntries()); }
+
+    bool usesPropertyOverlay() const { return base && (header().flags & PAYLOAD_FLAG_PROPERTY_OVERLAY); }
+
+    bool hasLocale() const { return base && header().locale.language.length > 0; }
+
+    Locale locale() const {
+        const PayloadLocale& locale = header().locale;
+        return {cString(locale.tag), cString(locale.language), cString(locale.script), cString(locale.region),
+                cString(locale.variant)};
+    }
+
+    bool hasKernel() const {
+        if (!base) {
+            return false;
+        }
+        const PayloadKernel& kernel = header().kernel;
+        return kernel.sysname.length || kernel.release.length || kernel.version.length || kernel.machine.length;
+    }
+
+    Kernel kernel() const {
+        const PayloadKernel& kernel = header().kernel;
+        return {cString(kernel.sysname), cString(kernel.release), cString(kernel.version), cString(kernel.machine)};
+    }
+
+    Field field(size_t index) const {
+        const PayloadField& record = reinterpret_cast<const PayloadField*>(base + sizeof(PayloadHeader))[index];
+        return {static_cast<BuildFields::FieldClass>(record.fieldClass),
+                static_cast<BuildFields::FieldType>(record.fieldType), string(record.name),
+                reinterpret_cast<const char*>(base + record.value.offset), record.intValue, record.elementCount};
+    }
+
+private:
+    const uint8_t* base = nullptr;
+    size_t byteSize = 0;
+
+    const PayloadHeader& header() const { return *reinterpret_cast<const PayloadHeader*>(base); }
+
+    const PropertyBucket* propertyBuckets() const {
+        return reinterpret_cast<const PropertyBucket*>(base + header().properties.bucketOffset);
+    }
+
+    const FileEntry* fileEntries() const {
+        return reinterpret_cast<const FileEntry*>(base + header().files.entryOffset);
+    }
+
+    std::string_view string(PayloadString ref) const {
+        return {reinterpret_cast<const char*>(base + ref.offset), ref.length};
+    }
+
+    const char* cString(PayloadString ref) const {
+        return reinterpret_cast<const char*>(base + ref.offset);
+    }
+
+    static bool validString(const uint8_t* data, size_t size, PayloadString ref) {
+        return ref.offset < size && ref.length < size - ref.offset && data[ref.offset + ref.length] == '\0';
+    }
+
+    // 需能连同结尾的 '\0' 放入 utsname 的字段
+    static bool validKernelString(const uint8_t* data, size_t size, PayloadString ref) {
+        return validString(data, size, ref) && ref.length < sizeof(utsname::release);
+    }
+
+    // 每个非空桶指向区域内的完整条目, 且至少有一个空桶保证探测终止
+    static bool validProperties(const uint8_t* data, size_t size, const PayloadPropertyTable& table) {
+        if (table.bucketCount == 0) {
+            return table.count == 0;
+        }
+        if ((table.bucketCount & (table.bucketCount - 1)) != 0 || table.count >= table.bucketCount ||
+            table.bucketOffset % alignof(PropertyBucket) != 0 || table.entryOffset % alignof(PropertyEntry) != 0 ||
+            table.bucketOffset > size || (size - table.bucketOffset) / sizeof(PropertyBucket) < table.bucketCount ||
+            table.entryOffset > size || table.entrySize > size - table.entryOffset) {
+            return false;
+        }
+        const auto* buckets = reinterpret_cast<const PropertyBucket*>(data + table.bucketOffset);
+        uint32_t used = 0;
+        for (uint32_t i = 0; i < table.bucketCount; i++) {
+            uint32_t offset = buckets[i].entry;
+            if (offset == 0) {
+                continue;
+            }
+            size_t entryEnd = size_t(table.entryOffset) + table.entrySize;
+            if (offset < table.entryOffset || offset % alignof(PropertyEntry) != 0 ||
+                entryEnd - offset <= sizeof(PropertyEntry)) {
+                return false;
+            }
+            const auto* entry = reinterpret_cast<const PropertyEntry*>(data + offset);
+            const char* name = propertyName(entry);
+            if (!memchr(name, '\0', entryEnd - offset - sizeof(PropertyEntry)) ||
+                propertyValueLength(entry) >= PROP_VALUE_MAX ||
+                strnlen(entry->value, PROP_VALUE_MAX) != propertyValueLength(entry) ||
+                hashKey(name) != buckets[i].hash) {
+                return false;
+            }
+            used++;
+        }
+        return used == table.count;
+    }
+
+    // 桶与属性表同样校验; 每个非空桶指向条目数组中的一项, 其路径哈希与桶一致
+    static bool validFiles(const uint8_t* data, size_t size, const PayloadFileTable& table) {
+        if (table.bucketCount == 0) {
+            return table.count == 0;
+        }
+        if ((table.bucketCount & (table.bucketCount - 1)) != 0 || table.count >= table.bucketCount ||
+            table.bucketOffset % alignof(PropertyBucket) != 0 || table.entryOffset % alignof(FileEntry) != 0 ||
+            table.bucketOffset > size || (size - table.bucketOffset) / sizeof(PropertyBucket) < table.bucketCount ||
+            table.entryOffset > size || (size - table.entryOffset) / sizeof(FileEntry) < table.count) {
+            return false;
+        }
+        const auto* buckets = reinterpret_cast<const PropertyBucket*>(data + table.bucketOffset);
+        uint32_t used = 0;
+        for (uint32_t i = 0; i < table.bucketCount; i++) {
+            uint32_t offset = buckets[i].entry;
+            if (offset == 0) {
+                continue;
+            }
+            if (offset < table.entryOffset || (offset - table.entryOffset) % sizeof(FileEntry) != 0 ||
+                (offset - table.entryOffset) / sizeof(FileEntry) >= table.count) {
+                return false;
+            }
+            const auto* entry = reinterpret_cast<const FileEntry*>(data + offset);
+            if (!validString(data, size, entry->path) || !validString(data, size, entry->content) ||
+                hashKey(reinterpret_cast<const char*>(data + entry->path.offset)) != buckets[i].hash) {
+                return false;
+            }
+            used++;
+        }
+        return used == table.count;
+    }
+
+    // n 个元素之间恰有 n - 1 个内部分隔符; 空数组的 value 必须为空串
+    static bool validElements(const uint8_t* data, const PayloadField& record) {
+        if (record.fieldType != BuildFields::TYPE_STRING_ARRAY) {
+            return record.elementCount == 0;
+        }
+        if (record.elementCount == 0) {
+            return record.value.length == 0;
+        }
+        const uint8_t* begin = data + record.value.offset;
+        size_t separators = std::count(begin, begin + record.value.length, '\0');
+        return separators + 1 == record.elementCount;
+    }
+};
+
+} // namespace ProfilePayload
+
+#endif // PROFILE_PAYLOAD_HPP
@@ -0,0 +1,504 @@
+#ifndef PROPERTY_AREA_HPP
+#define PROPERTY_AREA_HPP
+
+#include "utils.hpp"
+#include "profile_payload.hpp"
+
+#include <cinttypes>
+#include <climits>
+#include <string_view>
+
+// /dev/__properties__ 属性区的私有覆盖 (profile 中 "propsMode": "overlay").
+//
+// bionic 以只读共享方式映射每个属性区文件, 属性按 '.' 分段组织成 trie, 取值存放在 prop_info 中.
+// Companion 加载配置时读取属性区, 把被覆盖属性的取值写入副本, 只保留被修改的页面, 连同目录写入
+// 密封 memfd; app 进程在 specialize 时把这些页面以 MAP_PRIVATE | MAP_FIXED 映射到 bionic 已有
+// 映射的对应位置. 之后 native 与 Java 的读取都以 libc 原本的速度得到伪装值, 不经过任何 hook.
+//
+// 覆盖页面是静态快照, 因此:
+//   - 页面上有可变属性 (非 ro.*) 或 dirty backup 区时放弃该属性, 交给 PLT hook;
+//   - 新增属性会修改 trie 节点, app 进程发现 bytesUsed 与快照不一致时放弃整个属性区.
+//
+// 镜像格式: OverlayHeader | OverlayArea[] | OverlayPage[] | 补齐到页 | 页面内容.
+// 偏移均相对于镜像起始位置, 镜像在 memfd 中按页对齐.
+namespace PropertyArea {
+
+constexpr const char* PROPERTIES_DIR = "/dev/__properties__";
+constexpr uint32_t AREA_MAGIC = 0x504f5250;   // "PROP"
+constexpr uint32_t AREA_VERSION = 0xfc6ed0ab;
+
+// 与 bionic 的 prop_area 一致
+struct AreaHeader {
+    uint32_t bytesUsed;
+    uint32_t serial;
+    uint32_t magic;
+    uint32_t version;
+    uint32_t reserved[28];
+};
+static_assert(sizeof(AreaHeader) == 128, "AreaHeader must match prop_area");
+
+// 与 bionic 的 prop_bt 一致; 偏移均相对于 AreaHeader 之后的数据区, 0 表示不存在
+struct TrieNode {
+    uint32_t nameLength;
+    uint32_t prop;
+    uint32_t left;
+    uint32_t right;
+    uint32_t children;
+    // 紧随其后为以 '\0' 结尾的名称片段
+};
+
+// 与 bionic 的 prop_info serial 标志一致
+constexpr uint32_t SERIAL_DIRTY = 1u;
+constexpr uint32_t SERIAL_LONG = 1u << 16;
+
+// 根节点之后是 dirty backup 区, 可变属性更新期间读者从这里读取旧值
+constexpr size_t DIRTY_BACKUP_END = sizeof(AreaHeader) + sizeof(TrieNode) + PROP_VALUE_MAX;
+
+constexpr uint32_t OVERLAY_MAGIC = 0x4f504446; // "FDPO"
+constexpr uint16_t OVERLAY_VERSION = 1;
+constexpr size_t MAX_AREA_NAME = 128;
+// 一个 profile 的覆盖涉及的属性区上限, app 进程以一个 64 位掩码记录已应用的属性区
+constexpr uint32_t MAX_OVERLAY_AREAS = 64;
+
+struct OverlayHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t reserved;
+    uint32_t pageSize;
+    uint32_t areaCount;
+    uint32_t pageCount;
+    uint32_t coveredCount; // 各属性区 coveredCount 之和
+};
+
+struct OverlayArea {
+    char name[MAX_AREA_NAME]; // PROPERTIES_DIR 下的文件名, 以 '\0' 结尾
+    uint32_t areaSize;
+    uint32_t bytesUsed;       // 生成快照时的取值, 不一致说明属性区已新增属性
+    uint32_t firstPage;
+    uint32_t pageCount;
+    uint32_t coveredCount;    // 本属性区中完成覆盖的属性数
+    uint32_t reserved;
+};
+
+struct OverlayPage {
+    uint32_t areaOffset;  // 页面在属性区中的偏移
+    uint32_t imageOffset; // 页面内容在镜像中的偏移
+};
+
+// 与 bionic 的 cmp_prop_name 一致: 先比较长度, 再比较内容
+inline int compareSegment(std::string_view name, const TrieNode* node) {
+    if (name.size() != node->nameLength) {
+        return name.size() < node->nameLength ? -1 : 1;
+    }
+    return memcmp(name.data(), reinterpret_cast<const char*>(node + 1), name.size());
+}
+
+// 对一个属性区文件内容的只读访问, 所有偏移都做边界检查
+class AreaReader {
+public:
+    AreaReader(const uint8_t* area, size_t size) : area(area), size(size) {}
+
+    bool valid() const {
+        if (size <= sizeof(AreaHeader) + sizeof(TrieNode) || size > UINT32_MAX) {
+            return false;
+        }
+        const auto* header = reinterpret_cast<const AreaHeader*>(area);
+        return header->magic == AREA_MAGIC && header->version == AREA_VERSION &&
+               header->bytesUsed <= size - sizeof(AreaHeader);
+    }
+
+    uint32_t bytesUsed() const { return reinterpret_cast<const AreaHeader*>(area)->bytesUsed; }
+
+    // 返回 prop_info 相对于属性区起始的偏移, 不存在时返回 0
+    uint32_t findProperty(std::string_view name) const {
+        const TrieNode* current = node(0);
+        while (current) {
+            size_t separator = name.find('.');
+            std::string_view segment = name.substr(0, separator);
+            if (segment.empty()) {
+                return 0;
+            }
+            current = current->children ? findSibling(node(current->children), segment) : nullptr;
+            if (separator == std::string_view::npos) {
+                break;
+            }
+            name.remove_prefix(separator + 1);
+        }
+        return current && property(current->prop) ? static_cast<uint32_t>(sizeof(AreaHeader) + current->prop) : 0;
+    }
+
+    // 遍历全部属性, visit(偏移, 条目); trie 损坏时返回 false
+    template <class Visit>
+    bool forEachProperty(Visit&& visit) const {
+        std::vector<uint32_t> pending{0};
+        size_t visited = 0;
+        while (!pending.empty()) {
+            const TrieNode* current = node(pending.back());
+            pending.pop_back();
+            // 每个节点至少占 sizeof(TrieNode), 超出即说明存在环
+            if (!current || ++visited > size / sizeof(TrieNode)) {
+                return false;
+            }
+            if (current->prop) {
+                const ProfilePayload::PropertyEntry* entry = property(current->prop);
+                if (!entry) {
+                    return false;
+                }
+                visit(static_cast<uint32_t>(sizeof(AreaHeader) + current->prop), entry);
+            }
+            for (uint32_t next : {current->right, current->children, current->left}) {
+                if (next) {
+                    pending.push_back(next);
+                }
+            }
+        }
+        return true;
+    }
+
+private:
+    const uint8_t* area;
+    size_t size;
+
+    const TrieNode* node(uint32_t offset) const {
+        size_t start = sizeof(AreaHeader) + size_t(offset);
+        if (offset % alignof(TrieNode) != 0 || start > size || size - start <= sizeof(TrieNode)) {
+            return nullptr;
+        }
+        const auto* result = reinterpret_cast<const TrieNode*>(area + start);
+        if (result->nameLength >= size - start - sizeof(TrieNode) ||
+            reinterpret_cast<const char*>(result + 1)[result->nameLength] != '\0') {
+            return nullptr;
+        }
+        return result;
+    }
+
+    const ProfilePayload::PropertyEntry* property(uint32_t offset) const {
+        size_t start = sizeof(AreaHeader) + size_t(offset);
+        if (offset == 0 || offset % alignof(ProfilePayload::PropertyEntry) != 0 || start > size ||
+            size - start <= sizeof(ProfilePayload::PropertyEntry)) {
+            return nullptr;
+        }
+        const auto* entry = reinterpret_cast<const ProfilePayload::PropertyEntry*>(area + start);
+        const char* name = ProfilePayload::propertyName(entry);
+        return memchr(name, '\0', size - start - sizeof(ProfilePayload::PropertyEntry)) ? entry : nullptr;
+    }
+
+    const TrieNode* findSibling(const TrieNode* current, std::string_view segment) const {
+        // 同层节点构成二叉搜索树, 深度不会超过节点总数
+        for (size_t steps = 0; current && steps <= size / sizeof(TrieNode); steps++) {
+            int order = compareSegment(segment, current);
+            if (order == 0) {
+                return current;
+            }
+            uint32_t next = order < 0 ? current->left : current->right;
+            current = next ? node(next) : nullptr;
+        }
+        return nullptr;
+    }
+};
+
+// 为一个 profile 生成覆盖镜像. 只处理调用方传入的内存, 不访问文件系统
+class OverlayBuilder {
+public:
+    OverlayBuilder(const ProfilePayload::View& profile, uint32_t pageSize) : profile(profile), pageSize(pageSize) {}
+
+    // area 为一个属性区文件的完整内容, name 为其在 PROPERTIES_DIR 下的文件名
+    void addArea(std::string_view name, const uint8_t* area, size_t size) {
+        AreaReader reader(area, size);
+        if (name.size() >= MAX_AREA_NAME || !reader.valid()) {
+            return;
+        }
+
+        std::vector<std::pair<uint32_t, const ProfilePayload::PropertyEntry*>> matches;
+        for (uint32_t bucket = 0; bucket < profile.propertyBucketCount(); bucket++) {
+            const ProfilePayload::PropertyEntry* entry = profile.propertyAt(bucket);
+            if (!entry) {
+                continue;
+            }
+            if (uint32_t offset = reader.findProperty(ProfilePayload::propertyName(entry))) {
+                matches.emplace_back(offset, entry);
+            }
+        }
+        if (matches.empty()) {
+            return;
+        }
+
+        size_t pageCount = (size + pageSize - 1) / pageSize;
+        std::vector<bool> mutablePages(pageCount, false);
+        bool hasMutable = false;
+        bool intact = reader.forEachProperty([&](uint32_t offset, const ProfilePayload::PropertyEntry* entry) {
+            const char* entryName = ProfilePayload::propertyName(entry);
+            if (strncmp(entryName, "ro.", 3) != 0) {
+                hasMutable = true;
+                markPages(mutablePages, offset, sizeof(*entry) + strlen(entryName) + 1);
+            }
+        });
+        if (!intact) {
+            LOGW("属性区 trie 无效，跳过: %.*s", static_cast<int>(name.size()), name.data());
+            return;
+        }
+        if (hasMutable) {
+            markPages(mutablePages, 0, DIRTY_BACKUP_END);
+        }
+
+        std::vector<uint8_t> copy(area, area + size);
+        std::vector<bool> patchedPages(pageCount, false);
+        OverlayArea record{};
+        memcpy(record.name, name.data(), name.size());
+        record.areaSize = static_cast<uint32_t>(size);
+        record.bytesUsed = reader.bytesUsed();
+        for (const auto& [offset, entry] : matches) {
+            size_t first = offset / pageSize;
+            size_t last = (offset + sizeof(*entry) - 1) / pageSize;
+            if (std::find(mutablePages.begin() + first, mutablePages.begin() + last + 1, true) !=
+                mutablePages.begin() + last + 1) {
+                LOGW("属性 %s 与可变属性共享页面，无法覆盖", ProfilePayload::propertyName(entry));
+                continue;
+            }
+            patchValue(copy.data() + offset, entry);
+            std::fill(patchedPages.begin() + first, patchedPages.begin() + last + 1, true);
+            record.coveredCount++;
+        }
+        if (record.coveredCount == 0) {
+            return;
+        }
+        if (areas.size() == MAX_OVERLAY_AREAS) {
+            LOGW("覆盖涉及的属性区过多，跳过: %.*s", static_cast<int>(name.size()), name.data());
+            return;
+        }
+
+        record.firstPage = static_cast<uint32_t>(pages.size());
+        for (size_t page = 0; page < pageCount; page++) {
+            if (patchedPages[page]) {
+                size_t begin = page * pageSize;
+                size_t length = std::min<size_t>(pageSize, size - begin);
+                pages.push_back({static_cast<uint32_t>(begin), 0});
+                images.insert(images.end(), copy.begin() + begin, copy.begin() + begin + length);
+                images.resize(pages.size() * pageSize, 0);
+            }
+        }
+        record.pageCount = static_cast<uint32_t>(pages.size()) - record.firstPage;
+        areas.push_back(record);
+        covered += record.coveredCount;
+    }
+
+    uint32_t coveredCount() const { return covered; }
+
+    // 没有任何属性完成覆盖时返回空
+    std::vector<uint8_t> finish() const {
+        if (covered == 0) {
+            return {};
+        }
+        size_t directorySize = sizeof(OverlayHeader) + areas.size() * sizeof(OverlayArea) +
+                               pages.size() * sizeof(OverlayPage);
+        size_t imageBase = (directorySize + pageSize - 1) / pageSize * pageSize;
+        std::vector<uint8_t> overlay(imageBase + images.size(), 0);
+
+        OverlayHeader header{OVERLAY_MAGIC, OVERLAY_VERSION, 0, pageSize, static_cast<uint32_t>(areas.size()),
+                             static_cast<uint32_t>(pages.size()), covered};
+        memcpy(overlay.data(), &header, sizeof(header));
+        memcpy(overlay.data() + sizeof(header), areas.data(), areas.size() * sizeof(OverlayArea));
+        uint8_t* pageRecords = overlay.data() + sizeof(header) + areas.size() * sizeof(OverlayArea);
+        for (size_t i = 0; i < pages.size(); i++) {
+            OverlayPage page{pages[i].areaOffset, static_cast<uint32_t>(imageBase + i * pageSize)};
+            memcpy(pageRecords + i * sizeof(OverlayPage), &page, sizeof(page));
+        }
+        memcpy(overlay.data() + imageBase, images.data(), images.size());
+        return overlay;
+    }
+
+private:
+    ProfilePayload::View profile;
+    uint32_t pageSize;
+    std::vector<OverlayArea> areas;
+    std::vector<OverlayPage> pages;
+    std::vector<uint8_t> images;
+    uint32_t covered = 0;
+
+    void markPages(std::vector<bool>& marks, size_t offset, size_t length) const {
+        size_t last = std::min((offset + length - 1) / pageSize, marks.size() - 1);
+        for (size_t page = offset / pageSize; page <= last; page++) {
+            marks[page] = true;
+        }
+    }
+
+    // 保留序号并清除 dirty / long 标志; 长属性改写为普通取值后, 原取值所在的区域不再被引用
+    static void patchValue(uint8_t* target, const ProfilePayload::PropertyEntry* entry) {
+        ProfilePayload::PropertyEntry patched{};
+        memcpy(&patched, target, sizeof(patched));
+        uint32_t length = ProfilePayload::propertyValueLength(entry);
+        patched.serial = (length << 24) | (patched.serial & 0xffffff & ~(SERIAL_DIRTY | SERIAL_LONG));
+        memset(patched.value, 0, sizeof(patched.value));
+        memcpy(patched.value, entry->value, length);
+        memcpy(target, &patched, sizeof(patched));
+    }
+};
+
+// 覆盖镜像的只读视图, attach 时完成全部校验
+class OverlayView {
+public:
+    bool attach(const uint8_t* data, size_t size) {
+        base = nullptr;
+        if (size < sizeof(OverlayHeader) || reinterpret_cast<uintptr_t>(data) % alignof(OverlayHeader) != 0) {
+            return false;
+        }
+        const auto* header = reinterpret_cast<const OverlayHeader*>(data);
+        if (header->magic != OVERLAY_MAGIC || header->version != OVERLAY_VERSION || header->pageSize == 0 ||
+            header->areaCount > MAX_OVERLAY_AREAS ||
+            (size - sizeof(OverlayHeader)) / sizeof(OverlayArea) < header->areaCount ||
+            (size - sizeof(OverlayHeader) - header->areaCount * sizeof(OverlayArea)) / sizeof(OverlayPage) <
+                header->pageCount) {
+            return false;
+        }
+        const auto* areaRecords = reinterpret_cast<const OverlayArea*>(data + sizeof(OverlayHeader));
+        const auto* pageRecords = reinterpret_cast<const OverlayPage*>(areaRecords + header->areaCount);
+        uint32_t covered = 0;
+        for (uint32_t i = 0; i < header->areaCount; i++) {
+            const OverlayArea& area = areaRecords[i];
+            if (!memchr(area.name, '\0', sizeof(area.name)) || area.firstPage > header->pageCount ||
+                area.pageCount > header->pageCount - area.firstPage) {
+                return false;
+            }
+            for (uint32_t j = area.firstPage; j < area.firstPage + area.pageCount; j++) {
+                const OverlayPage& page = pageRecords[j];
+                if (page.areaOffset % header->pageSize != 0 || page.areaOffset >= area.areaSize ||
+                    page.imageOffset % header->pageSize != 0 || page.imageOffset > size ||
+                    size - page.imageOffset < header->pageSize) {
+                    return false;
+                }
+            }
+            covered += area.coveredCount;
+        }
+        if (covered != header->coveredCount) {
+            return false;
+        }
+        base = data;
+        return true;
+    }
+
+    const OverlayHeader& header() const { return *reinterpret_cast<const OverlayHeader*>(base); }
+
+    // 返回属性区在目录中的下标, 不存在时返回 -1
+    int findArea(std::string_view name) const {
+        for (uint32_t i = 0; i < header().areaCount; i++) {
+            if (name == area(i).name) {
+                return static_cast<int>(i);
+            }
+        }
+        return -1;
+    }
+
+    const OverlayArea& area(uint32_t index) const {
+        return reinterpret_cast<const OverlayArea*>(base + sizeof(OverlayHeader))[index];
+    }
+
+    const OverlayPage& page(uint32_t index) const {
+        const auto* pageRecords = reinterpret_cast<const OverlayPage*>(
+            base + sizeof(OverlayHeader) + header().areaCount * sizeof(OverlayArea));
+        return pageRecords[index];
+    }
+
+private:
+    const uint8_t* base = nullptr;
+};
+
+// bionic 的映射仍与生成快照时的属性区一致; 新增属性会改变 bytesUsed
+inline bool matchesSnapshot(const OverlayArea& area, const uint8_t* mapping) {
+    const auto* live = reinterpret_cast<const AreaHeader*>(mapping);
+    return live->magic == AREA_MAGIC && live->bytesUsed == area.bytesUsed;
+}
+
+// 把一个属性区的覆盖页面映射到 bionic 已有的映射上. 映射失败时尽量换回原文件内容, 避免留下空洞
+inline bool mapAreaPages(const OverlayView& overlay, const OverlayArea& area, uint8_t* mapping, int fd,
+                         uint64_t overlayOffset) {
+    uint32_t pageSize = overlay.header().pageSize;
+    for (uint32_t i = area.firstPage; i < area.firstPage + area.pageCount; i++) {
+        const OverlayPage& page = overlay.page(i);
+        void* target = mapping + page.areaOffset;
+        if (mmap(target, pageSize, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd,
+                 static_cast<off_t>(overlayOffset + page.imageOffset)) != MAP_FAILED) {
+            continue;
+        }
+        LOGE("映射属性区覆盖页面失败: %s+0x%x: %s", area.name, page.areaOffset, strerror(errno));
+        char path[PATH_MAX];
+        snprintf(path, sizeof(path), "%s/%s", PROPERTIES_DIR, area.name);
+        int areaFd = open(path, O_RDONLY | O_CLOEXEC | O_NOFOLLOW);
+        for (uint32_t j = area.firstPage; j <= i; j++) {
+            uint32_t offset = overlay.page(j).areaOffset;
+            if (areaFd < 0 ||
+                mmap(mapping + offset, pageSize, PROT_READ, MAP_SHARED | MAP_FIXED, areaFd, offset) == MAP_FAILED) {
+                LOGE("无法恢复属性区页面: %s+0x%x", area.name, offset);
+            }
+        }
+        if (areaFd >= 0) {
+            close(areaFd);
+        }
+        return false;
+    }
+    return true;
+}
+
+// 把覆盖镜像应用到本进程中 bionic 已映射的属性区, 返回完成覆盖的属性数.
+// 调用前先让 bionic 打开被覆盖属性所在的属性区, 之后才能在 /proc/self/maps 中找到它们
+inline uint32_t applyOverlay(const ProfilePayload::View& profile, const OverlayView& overlay, int fd,
+                             uint64_t overlayOffset) {
+    uint32_t pageSize = overlay.header().pageSize;
+    if (pageSize != static_cast<uint32_t>(sysconf(_SC_PAGESIZE)) || overlayOffset % pageSize != 0) {
+        LOGW("覆盖镜像与本进程页大小不匹配: %u", pageSize);
+        return 0;
+    }
+    for (uint32_t bucket = 0; bucket < profile.propertyBucketCount(); bucket++) {
+        if (const ProfilePayload::PropertyEntry* entry = profile.propertyAt(bucket)) {
+            __system_property_find(ProfilePayload::propertyName(entry));
+        }
+    }
+
+    LineReader maps("/proc/self/maps");
+    if (!maps.valid()) {
+        LOGE("无法读取 /proc/self/maps: %s", strerror(errno));
+        return 0;
+    }
+    // 同一属性区只计数一次
+    uint64_t applied = 0;
+    uint32_t covered = 0;
+    char line[PATH_MAX + 128];
+    size_t dirLength = strlen(PROPERTIES_DIR);
+    while (maps.next(line, sizeof(line))) {
+        uintptr_t start = 0;
+        uintptr_t end = 0;
+        unsigned long offset = 0;
+        int pathStart = 0;
+        if (sscanf(line, "%" SCNxPTR "-%" SCNxPTR " %*s %lx %*s %*s %n", &start, &end, &offset, &pathStart) != 3 ||
+            offset != 0 || pathStart == 0) {
+            continue;
+        }
+        std::string_view path(line + pathStart);
+        while (!path.empty() && path.back() == ' ') {
+            path.remove_suffix(1);
+        }
+        if (path.size() <= dirLength + 1 || path.substr(0, dirLength) != PROPERTIES_DIR || path[dirLength] != '/') {
+            continue;
+        }
+        std::string_view name = path.substr(dirLength + 1);
+        int index = overlay.findArea(name);
+        if (index < 0 || end - start < overlay.area(index).areaSize) {
+            continue;
+        }
+        const OverlayArea& area = overlay.area(index);
+        auto* mapping = reinterpret_cast<uint8_t*>(start);
+        if (!matchesSnapshot(area, mapping)) {
+            LOGW("属性区已变化，放弃覆盖: %s", area.name);
+            continue;
+        }
+        if (mapAreaPages(overlay, area, mapping, fd, overlayOffset) && !(applied & (1ull << index))) {
+            applied |= 1ull << index;
+            covered += area.coveredCount;
+        }
+    }
+    LOGD("属性区覆盖完成: %u/%u 个属性", covered, overlay.header().coveredCount);
+    return covered;
+}
+
+} // namespace PropertyArea
+
+#endif // PROPERTY_AREA_HPP
@@ -0,0 +1,330 @@
+#ifndef PROPERTY_HOOKS_HPP
+#define PROPERTY_HOOKS_HPP
+
+#include "utils.hpp"
+#include "zygisk.hpp"
+#include "plt_hooks.hpp"
+#include "profile_payload.hpp"
+
+#include <cerrno>
+#include <cstdlib>
+
+// 通过 PLT hook 让 native 代码读取系统属性时得到 profile 中 props 的取值,
+// 并替换 android.os.SystemProperties 的 native 方法, 让 Java 层读取得到同样的取值.
+// __system_property_foreach 枚举时同样换成伪装条目, 并补充系统中不存在的被覆盖属性.
+//
+// 覆盖表即 Companion 下发的配置记录 (调用方已复制为常驻的只读映射); 被覆盖的属性以记录中
+// 与 prop_info 布局一致的条目作为 prop_info 指针返回. 未覆盖的属性只多一次哈希探测.
+namespace PropertyHooks {
+
+inline zygisk::Api* api = nullptr;
+inline ProfilePayload::View overrides;
+
+using ReadCallback = void (*)(void* cookie, const char* name, const char* value, uint32_t serial);
+
+inline int (*originalGet)(const char*, char*) = nullptr;
+inline const prop_info* (*originalFind)(const char*) = nullptr;
+inline int (*originalRead)(const prop_info*, char*, char*) = nullptr;
+inline void (*originalReadCallback)(const prop_info*, ReadCallback, void*) = nullptr;
+
+using ForeachCallback = void (*)(const prop_info* pi, void* cookie);
+inline int (*originalForeach)(ForeachCallback, void*) = nullptr;
+// 系统中不存在的被覆盖属性, 在枚举结束时补充给调用方; install 时确定
+inline const ProfilePayload::PropertyEntry** extraEntries = nullptr;
+inline size_t extraEntryCount = 0;
+
+inline const ProfilePayload::PropertyEntry* ownEntry(const prop_info* pi) {
+    return overrides.ownsProperty(pi) ? reinterpret_cast<const ProfilePayload::PropertyEntry*>(pi) : nullptr;
+}
+
+inline int hookedGet(const char* name, char* value) {
+    if (const ProfilePayload::PropertyEntry* entry = overrides.findProperty(name)) {
+        uint32_t length = ProfilePayload::propertyValueLength(entry);
+        memcpy(value, entry->value, length + 1);
+        return static_cast<int>(length);
+    }
+    return originalGet(name, value);
+}
+
+inline const prop_info* hookedFind(const char* name) {
+    if (const ProfilePayload::PropertyEntry* entry = overrides.findProperty(name)) {
+        return reinterpret_cast<const prop_info*>(entry);
+    }
+    return originalFind(name);
+}
+
+// 与 bionic 一致: 名称按 PROP_NAME_MAX 截断, 取值完整复制
+inline int hookedRead(const prop_info* pi, char* name, char* value) {
+    const ProfilePayload::PropertyEntry* entry = ownEntry(pi);
+    if (!entry) {
+        return originalRead(pi, name, value);
+    }
+    if (name) {
+        const char* entryName = ProfilePayload::propertyName(entry);
+        size_t nameLength = strnlen(entryName, PROP_NAME_MAX - 1);
+        memcpy(name, entryName, nameLength);
+        name[nameLength] = '\0';
+    }
+    uint32_t length = ProfilePayload::propertyValueLength(entry);
+    memcpy(value, entry->value, length + 1);
+    return static_cast<int>(length);
+}
+
+inline void hookedReadCallback(const prop_info* pi, ReadCallback callback, void* cookie) {
+    const ProfilePayload::PropertyEntry* entry = ownEntry(pi);
+    if (!entry) {
+        originalReadCallback(pi, callback, cookie);
+        return;
+    }
+    callback(cookie, ProfilePayload::propertyName(entry), entry->value, entry->serial);
+}
+
+struct ForeachContext {
+    ForeachCallback callback;
+    void* cookie;
+};
+
+// bionic 的 prop_info 名称紧随 serial 与 value 之后, 与 PropertyEntry 布局相同;
+// 每条记录只做一次哈希探测, 被覆盖的属性换成记录中的条目
+inline void substituteEntry(const prop_info* pi, void* cookie) {
+    auto* context = static_cast<ForeachContext*>(cookie);
+    const char* name = ProfilePayload::propertyName(reinterpret_cast<const ProfilePayload::PropertyEntry*>(pi));
+    if (const ProfilePayload::PropertyEntry* entry = overrides.findProperty(name)) {
+        pi = reinterpret_cast<const prop_info*>(entry);
+    }
+    context->callback(pi, context->cookie);
+}
+
+// 调用方随后经 __system_property_read(_callback) 读取条目, 两者都已 hook; 未 hook 的 libc 内部读取
+// 也能得到正确取值, 因为条目与 prop_info 布局一致
+inline int hookedForeach(ForeachCallback callback, void* cookie) {
+    ForeachContext context{callback, cookie};
+    int result = originalForeach(substituteEntry, &context);
+    if (result == 0) {
+        for (size_t i = 0; i < extraEntryCount; i++) {
+            callback(reinterpret_cast<const prop_info*>(extraEntries[i]), cookie);
+        }
+    }
+    return result;
+}
+
+// 记录系统中不存在的被覆盖属性; 须在提交 PLT hook 之前调用, 以免本模块的查询被自身拦截
+inline void collectExtraEntries() {
+    size_t count = 0;
+    for (uint32_t bucket = 0; bucket < overrides.propertyBucketCount(); bucket++) {
+        const ProfilePayload::PropertyEntry* entry = overrides.propertyAt(bucket);
+        if (entry && !__system_property_find(ProfilePayload::propertyName(entry))) {
+            count++;
+        }
+    }
+    if (count == 0) {
+        return;
+    }
+    void* memory = mmap(nullptr, count * sizeof(*extraEntries), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS,
+                        -1, 0);
+    if (memory == MAP_FAILED) {
+        LOGE("无法为枚举补充表分配内存: %s", strerror(errno));
+        return;
+    }
+    auto* entries = static_cast<const ProfilePayload::PropertyEntry**>(memory);
+    for (uint32_t bucket = 0; bucket < overrides.propertyBucketCount(); bucket++) {
+        const ProfilePayload::PropertyEntry* entry = overrides.propertyAt(bucket);
+        if (entry && !__system_property_find(ProfilePayload::propertyName(entry))) {
+            entries[extraEntryCount++] = entry;
+        }
+    }
+    extraEntries = entries;
+}
+
+// SystemProperties 的 native 方法. Java 取值在 specialize 时按桶预先构造 (字符串为全局引用,
+// 整数与布尔值预先解析), 调用时只需复制一次键名并做一次哈希探测; 未覆盖的键转交原方法
+struct JavaValue {
+    jstring string;     // 全局引用
+    int64_t integer;
+    bool integerValid;
+    int8_t boolean;     // 1 / 0, 无法解析为布尔值时为 -1
+};
+inline JavaValue* javaValues = nullptr; // 与 overrides 的哈希桶一一对应, 空桶不使用
+
+// 更长的键不可能被覆盖 (Companion 拒绝超长属性名), 直接转交原方法
+constexpr jsize MAX_JAVA_KEY_LENGTH = 255;
+
+inline jstring (*originalNativeGet)(JNIEnv*, jclass, jstring) = nullptr;
+inline jstring (*originalNativeGetWithDefault)(JNIEnv*, jclass, jstring, jstring) = nullptr;
+inline jint (*originalNativeGetInt)(JNIEnv*, jclass, jstring, jint) = nullptr;
+inline jlong (*originalNativeGetLong)(JNIEnv*, jclass, jstring, jlong) = nullptr;
+inline jboolean (*originalNativeGetBoolean)(JNIEnv*, jclass, jstring, jboolean) = nullptr;
+
+inline const JavaValue* findJavaValue(JNIEnv* env, jstring key) {
+    // key 为 null 时由原方法抛出 NullPointerException
+    if (!key) {
+        return nullptr;
+    }
+    jsize length = env->GetStringUTFLength(key);
+    if (length > MAX_JAVA_KEY_LENGTH) {
+        return nullptr;
+    }
+    char name[MAX_JAVA_KEY_LENGTH + 1];
+    env->GetStringUTFRegion(key, 0, env->GetStringLength(key), name);
+    name[length] = '\0';
+    int bucket = overrides.findPropertyBucket(name);
+    return bucket >= 0 ? &javaValues[bucket] : nullptr;
+}
+
+inline jstring hookedNativeGet(JNIEnv* env, jclass clazz, jstring key) {
+    if (const JavaValue* value = findJavaValue(env, key)) {
+        return static_cast<jstring>(env->NewLocalRef(value->string));
+    }
+    return originalNativeGet(env, clazz, key);
+}
+
+// 与 framework 一致: 取值为空时返回默认值
+inline jstring hookedNativeGetWithDefault(JNIEnv* env, jclass clazz, jstring key, jstring def) {
+    if (const JavaValue* value = findJavaValue(env, key)) {
+        if (def && env->GetStringLength(value->string) == 0) {
+            return def;
+        }
+        return static_cast<jstring>(env->NewLocalRef(value->string));
+    }
+    return originalNativeGetWithDefault(env, clazz, key, def);
+}
+
+inline jint hookedNativeGetInt(JNIEnv* env, jclass clazz, jstring key, jint def) {
+    if (const JavaValue* value = findJavaValue(env, key)) {
+        return value->integerValid && value->integer >= INT32_MIN && value->integer <= INT32_MAX
+                   ? static_cast<jint>(value->integer)
+                   : def;
+    }
+    return originalNativeGetInt(env, clazz, key, def);
+}
+
+inline jlong hookedNativeGetLong(JNIEnv* env, jclass clazz, jstring key, jlong def) {
+    if (const JavaValue* value = findJavaValue(env, key)) {
+        return value->integerValid ? value->integer : def;
+    }
+    return originalNativeGetLong(env, clazz, key, def);
+}
+
+inline jboolean hookedNativeGetBoolean(JNIEnv* env, jclass clazz, jstring key, jboolean def) {
+    if (const JavaValue* value = findJavaValue(env, key)) {
+        return value->boolean >= 0 ? static_cast<jboolean>(value->boolean) : def;
+    }
+    return originalNativeGetBoolean(env, clazz, key, def);
+}
+
+// 与 android::base::ParseInt 一致: 支持前导空白, 符号与 0x 前缀, 必须完整解析
+inline bool parseJavaInteger(const char* text, int64_t& result) {
+    if (*text == '\0') {
+        return false;
+    }
+    char* end = nullptr;
+    errno = 0;
+    long long value = strtoll(text, &end, 0);
+    if (errno != 0 || *end != '\0') {
+        return false;
+    }
+    result = value;
+    return true;
+}
+
+// 与 android::base::ParseBool 一致
+inline int8_t parseJavaBoolean(std::string_view text) {
+    if (text == "1" || text == "y" || text == "yes" || text == "on" || text == "true") {
+        return 1;
+    }
+    if (text == "0" || text == "n" || text == "no" || text == "off" || text == "false") {
+        return 0;
+    }
+    return -1;
+}
+
+// 为每个被覆盖的属性构造 Java 取值, 失败时不安装 JNI hook
+inline bool prepareJavaValues(JNIEnv* env) {
+    uint32_t bucketCount = overrides.propertyBucketCount();
+    void* memory = mmap(nullptr, bucketCount * sizeof(JavaValue), PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED) {
+        LOGE("无法为 Java 属性取值分配内存: %s", strerror(errno));
+        return false;
+    }
+    auto* values = static_cast<JavaValue*>(memory);
+    for (uint32_t i = 0; i < bucketCount; i++) {
+        const ProfilePayload::PropertyEntry* entry = overrides.propertyAt(i);
+        if (!entry) {
+            continue;
+        }
+        jstring local = env->NewStringUTF(entry->value);
+        if (!local) {
+            env->ExceptionClear();
+            LOGE("无法创建属性取值字符串: %s", ProfilePayload::propertyName(entry));
+            for (uint32_t j = 0; j < i; j++) {
+                if (values[j].string) {
+                    env->DeleteGlobalRef(values[j].string);
+                }
+            }
+            munmap(memory, bucketCount * sizeof(JavaValue));
+            return false;
+        }
+        JavaValue& value = values[i];
+        value.string = static_cast<jstring>(env->NewGlobalRef(local));
+        env->DeleteLocalRef(local);
+        value.integerValid = parseJavaInteger(entry->value, value.integer);
+        value.boolean = parseJavaBoolean({entry->value, ProfilePayload::propertyValueLength(entry)});
+    }
+    javaValues = values;
+    return true;
+}
+
+// 返回是否有方法被替换. API 26/27 另有单参数的 native_get(String), 不存在的方法其 fnPtr 被置空
+inline bool installJniHooks(JNIEnv* env) {
+    if (!prepareJavaValues(env)) {
+        return false;
+    }
+    JNINativeMethod methods[] = {
+        {"native_get", "(Ljava/lang/String;)Ljava/lang/String;", reinterpret_cast<void*>(hookedNativeGet)},
+        {"native_get", "(Ljava/lang/String;Ljava/lang/String;)Ljava/lang/String;",
+         reinterpret_cast<void*>(hookedNativeGetWithDefault)},
+        {"native_get_int", "(Ljava/lang/String;I)I", reinterpret_cast<void*>(hookedNativeGetInt)},
+        {"native_get_long", "(Ljava/lang/String;J)J", reinterpret_cast<void*>(hookedNativeGetLong)},
+        {"native_get_boolean", "(Ljava/lang/String;Z)Z", reinterpret_cast<void*>(hookedNativeGetBoolean)},
+    };
+    api->hookJniNativeMethods(env, "android/os/SystemProperties", methods, std::size(methods));
+    *reinterpret_cast<void**>(&originalNativeGet) = methods[0].fnPtr;
+    *reinterpret_cast<void**>(&originalNativeGetWithDefault) = methods[1].fnPtr;
+    *reinterpret_cast<void**>(&originalNativeGetInt) = methods[2].fnPtr;
+    *reinterpret_cast<void**>(&originalNativeGetLong) = methods[3].fnPtr;
+    *reinterpret_cast<void**>(&originalNativeGetBoolean) = methods[4].fnPtr;
+
+    size_t hooked = 0;
+    for (const JNINativeMethod& method : methods) {
+        if (method.fnPtr) {
+            hooked++;
+        }
+    }
+    LOGD("已替换 %zu 个 SystemProperties native 方法", hooked);
+    return hooked > 0;
+}
+
+// 登记属性相关的 PLT hook 并替换 SystemProperties 的 native 方法; PLT hook 由调用方统一提交.
+// profile 必须在进程生命周期内有效. 返回 true 表示 JNI hook 已生效, 模块必须常驻
+inline bool install(zygisk::Api* zygiskApi, JNIEnv* env, const ProfilePayload::View& profile) {
+    api = zygiskApi;
+    overrides = profile;
+    collectExtraEntries();
+
+    PltHooks::add("__system_property_get", reinterpret_cast<void*>(hookedGet), reinterpret_cast<void**>(&originalGet));
+    PltHooks::add("__system_property_find", reinterpret_cast<void*>(hookedFind),
+                  reinterpret_cast<void**>(&originalFind));
+    PltHooks::add("__system_property_read", reinterpret_cast<void*>(hookedRead),
+                  reinterpret_cast<void**>(&originalRead));
+    PltHooks::add("__system_property_read_callback", reinterpret_cast<void*>(hookedReadCallback),
+                  reinterpret_cast<void**>(&originalReadCallback));
+    PltHooks::add("__system_property_foreach", reinterpret_cast<void*>(hookedForeach),
+                  reinterpret_cast<void**>(&originalForeach));
+    LOGD("已登记属性 hook, 覆盖 %zu 个属性", overrides.propertyCount());
+    return installJniHooks(env);
+}
+
+} // namespace PropertyHooks
+
+#endif // PROPERTY_HOOKS_HPP
@@ -0,0 +1,107 @@
+#ifndef PROTOCOL_HPP
+#define PROTOCOL_HPP
+
+#include <cstdint>
+#include <cstddef>
+
+// 模块与 Companion 之间的通信协议.
+//
+// 请求: RequestHeader + 进程名 (不含 '\0'), 一次 write 发出.
+// 响应: ResponseHeader + 数据, Companion 一次 write 发出, 客户端通常一次 recv 即可收完.
+//
+// 新增请求类型或数据格式时追加 RequestKind / Capability, 旧版本模块不会声明新能力,
+// Companion 据此返回其能理解的响应或 STATUS_UNSUPPORTED.
+namespace Protocol {
+
+constexpr uint32_t MAGIC = 0x50494446; // "FDIP"
+constexpr uint16_t VERSION = 1;
+
+constexpr size_t MAX_NICE_NAME_LENGTH = 256;
+
+// 模块一次交互 (发送请求到收完响应) 的时间预算, 超时即放弃伪装, 限定对冷启动的最大影响.
+// 可通过系统属性调整, 取值限制在 [MIN_IPC_TIMEOUT_MS, MAX_IPC_TIMEOUT_MS]
+constexpr const char* IPC_TIMEOUT_PROPERTY = "persist.fdi.ipc_timeout_ms";
+constexpr uint32_t DEFAULT_IPC_TIMEOUT_MS = 100;
+constexpr uint32_t MIN_IPC_TIMEOUT_MS = 10;
+constexpr uint32_t MAX_IPC_TIMEOUT_MS = 1000;
+// Companion 等待客户端请求的时间上限, 避免异常客户端长期占用处理线程
+constexpr uint32_t REQUEST_TIMEOUT_MS = 1000;
+
+enum RequestKind : uint16_t {
+    REQUEST_PROFILE = 1,
+};
+
+enum Capability : uint32_t {
+    // 旧版本模块的 JSON 配置格式, Companion 已不再提供
+    CAP_JSON_PROFILE = 1u << 0,
+    // 可接收 SCM_RIGHTS 传递的密封 memfd, 并直接在映射内存中读取配置
+    CAP_SHARED_PROFILE = 1u << 1,
+    // 配置数据为 ProfilePayload 二进制记录
+    CAP_BINARY_PROFILE = 1u << 2,
+    // 可把属性区覆盖镜像映射到本进程的属性区上 (需同时声明 CAP_SHARED_PROFILE)
+    CAP_PROPERTY_OVERLAY = 1u << 3,
+};
+
+enum RequestFlag : uint32_t {
+    REQUEST_FLAG_CHILD_ZYGOTE = 1u << 0,
+};
+
+enum ResponseStatus : uint16_t {
+    STATUS_MATCHED = 2,
+    STATUS_NO_MATCH = 3,
+    STATUS_BAD_REQUEST = 4,
+    STATUS_UNSUPPORTED = 5,
+};
+
+enum ResponseFlag : uint32_t {
+    // 数据为 SharedProfileLocation, 同一消息中附带存放全部配置的密封 memfd
+    RESPONSE_FLAG_SHARED_PROFILE = 1u << 0,
+    // SharedProfileLocation 之后紧跟 PropertyOverlayLocation, 消息附带的第二个 fd 为覆盖镜像 memfd
+    RESPONSE_FLAG_PROPERTY_OVERLAY = 1u << 1,
+};
+
+struct RequestHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t kind;
+    uint32_t flags;
+    uint32_t capabilities;
+    int32_t uid;
+    uint16_t niceNameLength;
+    uint16_t reserved;
+};
+
+struct ResponseHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t status;
+    uint32_t flags;
+    uint32_t payloadSize;
+};
+
+struct SharedProfileLocation {
+    uint32_t offset; // 配置数据在 memfd 中的偏移
+    uint32_t size;
+};
+
+struct PropertyOverlayLocation {
+    uint32_t offset; // 覆盖镜像在 memfd 中的偏移, 按页对齐
+    uint32_t size;
+};
+
+// 一条响应消息最多附带的 fd 数
+constexpr size_t MAX_RESPONSE_FDS = 2;
+
+constexpr size_t MAX_REQUEST_SIZE = sizeof(RequestHeader) + MAX_NICE_NAME_LENGTH;
+
+constexpr ResponseHeader makeResponseHeader(ResponseStatus status, uint32_t payloadSize = 0) {
+    return {MAGIC, VERSION, status, 0, payloadSize};
+}
+
+inline bool isValidResponse(const ResponseHeader& header) {
+    return header.magic == MAGIC && header.version == VERSION;
+}
+
+} // namespace Protocol
+
+#endif // PROTOCOL_HPP
@@ -0,0 +1,92 @@
+#ifndef SNAPSHOT_STORE_HPP
+#define SNAPSHOT_STORE_HPP
+
+#include "utils.hpp"
+
+#include <memory>
+
+// 以原子指针发布的不可变快照 (RCU 风格).
+//
+// 读者: 读取当前 epoch 的奇偶位, 在对应计数器上登记, 再加载快照指针; 全程无锁.
+// 写者: 原子替换指针后与 liburcu 的 synchronize_rcu 一样分两轮翻转 epoch, 每轮等待翻转前
+// 奇偶位上的读者全部离开, 再释放旧快照.
+// 读者读取奇偶位与登记之间可能被抢占, 晚于翻转登记在旧奇偶位上, 所以只等一轮不够. 持有旧指针的
+// 读者必然在替换之前完成登记, 两轮之后两个奇偶位都在替换之后被清空过一次, 它已经离开;
+// 每轮只等待一个奇偶位, 新进入的读者登记在另一个奇偶位上, 不会拖住回收.
+// 读者的 "登记 -> 加载指针" 与写者的 "替换指针 -> 翻转 epoch -> 读计数" 都是先写后读, acquire/release
+// 不禁止这种重排, 因此两侧的这些操作全部使用 seq_cst: 要么写者读到读者的登记, 要么读者读到新指针.
+template <class T>
+class SnapshotStore {
+public:
+    class ReadGuard {
+    public:
+        ReadGuard(const ReadGuard&) = delete;
+        ReadGuard& operator=(const ReadGuard&) = delete;
+
+        ~ReadGuard() {
+            counter.fetch_sub(1, std::memory_order_release);
+        }
+
+        const T* get() const { return snapshot; }
+        const T* operator->() const { return snapshot; }
+        explicit operator bool() const { return snapshot != nullptr; }
+
+    private:
+        friend class SnapshotStore;
+
+        ReadGuard(std::atomic<uint64_t>& counter, const T* snapshot)
+            : counter(counter), snapshot(snapshot) {}
+
+        std::atomic<uint64_t>& counter;
+        const T* snapshot;
+    };
+
+    SnapshotStore() = default;
+    SnapshotStore(const SnapshotStore&) = delete;
+    SnapshotStore& operator=(const SnapshotStore&) = delete;
+
+    ~SnapshotStore() {
+        delete current.load(std::memory_order_acquire);
+    }
+
+    ReadGuard read() const {
+        auto& counter = readers[epoch.load(std::memory_order_seq_cst) & 1].count;
+        counter.fetch_add(1, std::memory_order_seq_cst);
+        return ReadGuard(counter, current.load(std::memory_order_seq_cst));
+    }
+
+    // 发布新快照并在没有读者引用后回收旧快照; 可能短暂阻塞, 不要在查询路径上调用
+    void publish(std::unique_ptr<T> next) {
+        std::lock_guard lock(writerMutex);
+        T* old = current.exchange(next.release(), std::memory_order_seq_cst);
+        generation.fetch_add(1, std::memory_order_relaxed);
+
+        for (int phase = 0; phase < 2; phase++) {
+            uint32_t previous = epoch.fetch_add(1, std::memory_order_seq_cst) & 1;
+            while (readers[previous].count.load(std::memory_order_seq_cst) != 0) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        }
+        delete old;
+    }
+
+    uint64_t currentGeneration() const {
+        return generation.load(std::memory_order_relaxed);
+    }
+
+private:
+    // 主机测试借此逐步重放读者在登记前被抢占的交错
+    friend struct SnapshotStoreTestAccess;
+
+    struct alignas(64) ReaderCounter {
+        std::atomic<uint64_t> count{0};
+    };
+
+    std::atomic<T*> current{nullptr};
+    std::atomic<uint32_t> epoch{0};
+    std::atomic<uint64_t> generation{0};
+    mutable ReaderCounter readers[2];
+    std::mutex writerMutex;
+};
+
+#endif // SNAPSHOT_STORE_HPP
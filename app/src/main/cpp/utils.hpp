@@ -2,11 +2,32 @@
 #define UTILS_HPP
 
 #include <cstdio>
+#include <ctime>
+#include <dlfcn.h>
 #include <fcntl.h>
 #include <unistd.h>
+#include <poll.h>
+#include <jni.h>
 #include <android/log.h>
+#include <sys/inotify.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <linux/memfd.h>
 #include <sys/system_properties.h>
+#include <sys/xattr.h>
+#include <cerrno>
+#include <cstring>
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <cinttypes>
+#include <chrono>
 #include <filesystem>
+#include <map>
+#include <mutex>
+#include <thread>
 #include <unordered_map>
 #include <vector>
 #include <string>
@@ -24,11 +45,76 @@
 #define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
 #define LOGW(...) __android_log_print(ANDROID_LOG_WARN, LOG_TAG, __VA_ARGS__)
 
-inline bool safeWrite(int fd, const void *buffer, size_t size) {
+inline uint64_t monotonicNanos() {
+    struct timespec ts{};
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ull + ts.tv_nsec;
+}
+
+// 用 GetStringUTFRegion 把进程名复制到调用方的缓冲区, 避免 GetStringUTFChars 的分配与释放;
+// 超出缓冲区 (协议长度) 的进程名不可能匹配, 直接跳过
+template <size_t N>
+inline bool readNiceName(JNIEnv *env, jstring niceName, char (&buffer)[N]) {
+    if (!niceName) {
+        LOGE("无法获取进程名称");
+        return false;
+    }
+    jsize utfLength = env->GetStringUTFLength(niceName);
+    if (utfLength <= 0 || static_cast<size_t>(utfLength) >= N) {
+        LOGE("进程名长度无效: %d", utfLength);
+        return false;
+    }
+    env->GetStringUTFRegion(niceName, 0, env->GetStringLength(niceName), buffer);
+    buffer[utfLength] = '\0';
+    return true;
+}
+
+// 以 CLOCK_MONOTONIC 计的截止时间, 供一次交互中的多次 I/O 共享同一预算
+class Deadline {
+public:
+    explicit Deadline(uint32_t budgetMs) : expiresAt(monotonicNanos() + budgetMs * 1000000ull) {}
+
+    int remainingMs() const {
+        uint64_t now = monotonicNanos();
+        return now >= expiresAt ? 0 : static_cast<int>((expiresAt - now + 999999) / 1000000);
+    }
+
+    bool expired() const { return monotonicNanos() >= expiresAt; }
+
+private:
+    uint64_t expiresAt;
+};
+
+// 等待 fd 就绪; 超过截止时间返回 false 且 errno 为 ETIMEDOUT
+inline bool waitReady(int fd, short events, const Deadline &deadline) {
+    while (true) {
+        struct pollfd pfd = {fd, events, 0};
+        int result = poll(&pfd, 1, deadline.remainingMs());
+        if (result > 0) {
+            return true;
+        }
+        if (result < 0 && errno == EINTR) {
+            continue;
+        }
+        if (result == 0) {
+            errno = ETIMEDOUT;
+        }
+        return false;
+    }
+}
+
+// deadline 为空时阻塞直到完成; 否则每次 I/O 前用 poll 等待, 总耗时不超过截止时间
+inline bool safeWrite(int fd, const void *buffer, size_t size, const Deadline *deadline = nullptr) {
     size_t written = 0;
     const uint8_t *buf = static_cast<const uint8_t*>(buffer);
     while (written < size) {
+        if (deadline && !waitReady(fd, POLLOUT, *deadline)) {
+            return false;
+        }
         ssize_t result = write(fd, buf + written, size - written);
+        if (result < 0 && errno == EINTR) {
+            continue;
+        }
         if (result <= 0) {
             return false;
         }
@@ -37,4 +123,301 @@ inline bool safeWrite(int fd, const void *buffer, size_t size) {
     return true;
 }
 
+// 用于 socket: 对端已关闭时返回 false 而不是触发 SIGPIPE
+inline bool safeSend(int sock, const void *buffer, size_t size, const Deadline *deadline = nullptr) {
+    size_t sent = 0;
+    const uint8_t *buf = static_cast<const uint8_t*>(buffer);
+    while (sent < size) {
+        if (deadline && !waitReady(sock, POLLOUT, *deadline)) {
+            return false;
+        }
+        ssize_t result = send(sock, buf + sent, size - sent, MSG_NOSIGNAL);
+        if (result < 0 && errno == EINTR) {
+            continue;
+        }
+        if (result <= 0) {
+            return false;
+        }
+        sent += result;
+    }
+    return true;
+}
+
+inline bool safeRead(int fd, void *buffer, size_t size, const Deadline *deadline = nullptr) {
+    size_t received = 0;
+    uint8_t *buf = static_cast<uint8_t*>(buffer);
+    while (received < size) {
+        if (deadline && !waitReady(fd, POLLIN, *deadline)) {
+            return false;
+        }
+        ssize_t result = read(fd, buf + received, size - received);
+        if (result < 0 && errno == EINTR) {
+            continue;
+        }
+        if (result <= 0) {
+            return false;
+        }
+        received += result;
+    }
+    return true;
+}
+
+// 用 read 逐行读取 /proc 下的文本文件, 不经过 stdio, 不做堆分配; 读缓冲区在对象内, 通常放在栈上.
+// 超出调用方行缓冲区的行被截断, 其余部分丢弃
+class LineReader {
+public:
+    explicit LineReader(const char *path) : fd(open(path, O_RDONLY | O_CLOEXEC)) {}
+    LineReader(const LineReader&) = delete;
+    LineReader& operator=(const LineReader&) = delete;
+
+    ~LineReader() {
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+
+    bool valid() const { return fd >= 0; }
+
+    // 把下一行 (不含换行符) 以 '\0' 结尾写入 line, 读完或出错时返回 false
+    bool next(char *line, size_t size) {
+        size_t length = 0;
+        while (true) {
+            char *newline = static_cast<char*>(memchr(buffer + begin, '\n', end - begin));
+            size_t available = (newline ? newline - buffer : end) - begin;
+            size_t copied = std::min(available, size - 1 - length);
+            memcpy(line + length, buffer + begin, copied);
+            length += copied;
+            begin += available;
+            if (newline) {
+                begin++;
+                line[length] = '\0';
+                return true;
+            }
+            ssize_t result;
+            do {
+                result = read(fd, buffer, sizeof(buffer));
+            } while (result < 0 && errno == EINTR);
+            begin = 0;
+            end = result > 0 ? static_cast<size_t>(result) : 0;
+            if (result <= 0) {
+                // 最后一行可能没有换行符
+                line[length] = '\0';
+                return length > 0;
+            }
+        }
+    }
+
+private:
+    int fd;
+    size_t begin = 0;
+    size_t end = 0;
+    char buffer[2048];
+};
+
+// bionic 在 API 30 之前没有 memfd_create 封装
+inline int createMemfd(const char *name, unsigned int flags) {
+    return static_cast<int>(syscall(__NR_memfd_create, name, flags));
+}
+
+constexpr int FULL_MEMFD_SEALS = F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL;
+
+inline bool isFullySealed(int fd) {
+    int seals = fcntl(fd, F_GET_SEALS);
+    return seals >= 0 && (seals & FULL_MEMFD_SEALS) == FULL_MEMFD_SEALS;
+}
+
+// 一次 sendmsg 发送数据并通过 SCM_RIGHTS 附带 fdCount (不超过 MAX_PASSED_FDS) 个 fd
+constexpr size_t MAX_PASSED_FDS = 4;
+
+inline bool sendWithFds(int sock, const void *buffer, size_t size, const int *fds, size_t fdCount,
+                        const Deadline *deadline = nullptr) {
+    if (fdCount == 0 || fdCount > MAX_PASSED_FDS) {
+        errno = EINVAL;
+        return false;
+    }
+    struct iovec iov = {const_cast<void*>(buffer), size};
+    alignas(struct cmsghdr) char control[CMSG_SPACE(sizeof(int) * MAX_PASSED_FDS)] = {};
+    struct msghdr msg = {};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = CMSG_SPACE(sizeof(int) * fdCount);
+
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int) * fdCount);
+    memcpy(CMSG_DATA(cmsg), fds, sizeof(int) * fdCount);
+
+    if (deadline && !waitReady(sock, POLLOUT, *deadline)) {
+        return false;
+    }
+    ssize_t result;
+    do {
+        result = sendmsg(sock, &msg, MSG_NOSIGNAL);
+    } while (result < 0 && errno == EINTR);
+    if (result < 0) {
+        return false;
+    }
+    // fd 随第一个字节送达, 剩余数据按普通流写出
+    return static_cast<size_t>(result) == size ||
+           safeSend(sock, static_cast<const uint8_t*>(buffer) + result, size - result, deadline);
+}
+
+inline bool sendWithFd(int sock, const void *buffer, size_t size, int fd, const Deadline *deadline = nullptr) {
+    return sendWithFds(sock, buffer, size, &fd, 1, deadline);
+}
+
+// 一次 recvmsg 接收数据, 对端附带的 fd 依次写入 fds (最多 maxFds 个, 不超过 MAX_PASSED_FDS), 其余位置为 -1
+inline ssize_t recvWithFds(int sock, void *buffer, size_t size, int *fds, size_t maxFds,
+                           const Deadline *deadline = nullptr) {
+    maxFds = std::min(maxFds, MAX_PASSED_FDS);
+    struct iovec iov = {buffer, size};
+    alignas(struct cmsghdr) char control[CMSG_SPACE(sizeof(int) * MAX_PASSED_FDS)] = {};
+    struct msghdr msg = {};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = CMSG_SPACE(sizeof(int) * maxFds);
+
+    std::fill(fds, fds + maxFds, -1);
+    if (deadline && !waitReady(sock, POLLIN, *deadline)) {
+        return -1;
+    }
+    ssize_t result;
+    do {
+        result = recvmsg(sock, &msg, MSG_CMSG_CLOEXEC);
+    } while (result < 0 && errno == EINTR);
+    if (result < 0) {
+        return result;
+    }
+
+    for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+        if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS && cmsg->cmsg_len >= CMSG_LEN(0)) {
+            size_t count = std::min((cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int), maxFds);
+            memcpy(fds, CMSG_DATA(cmsg), count * sizeof(int));
+            break;
+        }
+    }
+    return result;
+}
+
+inline ssize_t recvWithFd(int sock, void *buffer, size_t size, int *fd, const Deadline *deadline = nullptr) {
+    return recvWithFds(sock, buffer, size, fd, 1, deadline);
+}
+
+// 只读映射 fd 中 [offset, offset + size) 的区域, 映射起点按页对齐
+class MappedRegion {
+public:
+    MappedRegion() = default;
+    MappedRegion(const MappedRegion&) = delete;
+    MappedRegion& operator=(const MappedRegion&) = delete;
+
+    ~MappedRegion() {
+        if (base) {
+            munmap(base, length);
+        }
+    }
+
+    bool map(int fd, uint64_t offset, size_t size) {
+        struct stat st{};
+        if (size == 0 || fstat(fd, &st) != 0 || offset > static_cast<uint64_t>(st.st_size) ||
+            size > static_cast<uint64_t>(st.st_size) - offset) {
+            return false;
+        }
+        uint64_t pageMask = static_cast<uint64_t>(sysconf(_SC_PAGESIZE)) - 1;
+        uint64_t alignedOffset = offset & ~pageMask;
+        size_t mapLength = static_cast<size_t>(offset - alignedOffset) + size;
+        void *addr = mmap(nullptr, mapLength, PROT_READ, MAP_SHARED, fd, static_cast<off_t>(alignedOffset));
+        if (addr == MAP_FAILED) {
+            return false;
+        }
+        base = addr;
+        length = mapLength;
+        begin = static_cast<const uint8_t*>(addr) + (offset - alignedOffset);
+        regionSize = size;
+        return true;
+    }
+
+    const uint8_t *data() const { return begin; }
+    size_t size() const { return regionSize; }
+
+private:
+    void *base = nullptr;
+    size_t length = 0;
+    const uint8_t *begin = nullptr;
+    size_t regionSize = 0;
+};
+
+// 一个 ELF 全部映射在 smaps 中的内存占用 (KiB)
+struct MappingFootprint {
+    uint64_t size;
+    uint64_t rss;
+    uint64_t pss;
+    uint64_t privateClean;
+    uint64_t privateDirty;
+};
+
+// 按 /proc/self/smaps 汇总 address 所在 ELF 的全部映射, 包括紧随其后的 .bss 匿名映射.
+// 读取 smaps 要遍历页表, 只用于调试日志
+inline bool readElfFootprint(const void *address, MappingFootprint &footprint) {
+    Dl_info info{};
+    if (!dladdr(address, &info) || !info.dli_fbase) {
+        return false;
+    }
+    LineReader smaps("/proc/self/smaps");
+    if (!smaps.valid()) {
+        return false;
+    }
+    auto base = reinterpret_cast<uintptr_t>(info.dli_fbase);
+    footprint = {};
+    unsigned long elfInode = 0;
+    unsigned int elfDev = 0;
+    // 上一个映射是否为该 ELF 的文件映射; .bss 只可能紧随其后
+    bool afterElfFile = false;
+    bool ours = false;
+    char line[PATH_MAX + 128];
+    while (smaps.next(line, sizeof(line))) {
+        const char *space = strchr(line, ' ');
+        const char *colon = strchr(line, ':');
+        if (colon && space && colon < space) {
+            // 统计行, 如 "Rss:  12 kB"
+            if (!ours) {
+                continue;
+            }
+            std::string_view key(line, colon - line);
+            uint64_t *target = key == "Size" ? &footprint.size
+                             : key == "Rss" ? &footprint.rss
+                             : key == "Pss" ? &footprint.pss
+                             : key == "Private_Clean" ? &footprint.privateClean
+                             : key == "Private_Dirty" ? &footprint.privateDirty
+                                                      : nullptr;
+            if (target) {
+                *target += strtoull(colon + 1, nullptr, 10);
+            }
+            continue;
+        }
+        uintptr_t start = 0;
+        uintptr_t end = 0;
+        unsigned int major = 0;
+        unsigned int minor = 0;
+        unsigned long inode = 0;
+        int pathStart = 0;
+        if (sscanf(line, "%" SCNxPTR "-%" SCNxPTR " %*s %*x %x:%x %lu %n", &start, &end, &major, &minor, &inode,
+                   &pathStart) != 5) {
+            continue;
+        }
+        std::string_view path(line + pathStart);
+        unsigned int dev = (major << 8) | minor;
+        if (start <= base && base < end) {
+            elfInode = inode;
+            elfDev = dev;
+        }
+        bool elfFile = elfInode != 0 && inode == elfInode && dev == elfDev;
+        ours = elfFile || (afterElfFile && inode == 0 && (path.empty() || path == "[anon:.bss]"));
+        afterElfFile = elfFile;
+    }
+    return elfInode != 0;
+}
+
 #endif // UTILS_HPP
\ No newline at end of file
@@ -0,0 +1,43 @@
+#ifndef BENCH_SUPPORT_HPP
+#define BENCH_SUPPORT_HPP
+
+#include "utils.hpp"
+
+#include <algorithm>
+#include <cstdio>
+
+// 主机基准: 预热后计时若干轮, 打印并返回最快一轮中每次调用的平均纳秒数. 结果只作相对比较, 不做断言,
+// 以免 ctest 在负载较高的机器上偶发失败. 迭代次数可用环境变量 BENCH_SCALE 整体放大
+inline size_t benchIterations(size_t base) {
+    const char* scale = getenv("BENCH_SCALE");
+    long factor = scale ? atol(scale) : 1;
+    return base * static_cast<size_t>(factor > 0 ? factor : 1);
+}
+
+constexpr int BENCH_ROUNDS = 5;
+
+template <class Body>
+inline double measure(const char* label, size_t iterations, Body&& body) {
+    for (size_t i = 0; i < iterations / 10 + 1; i++) {
+        body(i);
+    }
+    double best = 0;
+    for (int round = 0; round < BENCH_ROUNDS; round++) {
+        uint64_t start = monotonicNanos();
+        for (size_t i = 0; i < iterations; i++) {
+            body(i);
+        }
+        double perCall = static_cast<double>(monotonicNanos() - start) / static_cast<double>(iterations);
+        best = round == 0 ? perCall : std::min(best, perCall);
+    }
+    fprintf(stderr, "%10.1f ns/次  %s\n", best, label);
+    return best;
+}
+
+// 防止编译器消除被测调用
+template <class T>
+inline void keep(const T& value) {
+    asm volatile("" : : "g"(&value) : "memory");
+}
+
+#endif // BENCH_SUPPORT_HPP
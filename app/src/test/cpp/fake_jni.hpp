@@ -0,0 +1,405 @@
+#ifndef FAKE_JNI_HPP
+#define FAKE_JNI_HPP
+
+#include <jni.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string_view>
+
+// 主机测试用的最小 JNIEnv: 字符串只支持 ASCII, 引用即对象指针.
+// 对象取自固定大小的静态池, 与 ART 在 Java 堆上分配一样不经过 malloc, 分配计数测试因此只看到模块自身的
+// 堆分配. 局部引用在 DeleteLocalRef 或所在的局部引用帧弹出时归还, 升级为全局引用的对象一直保留.
+// 类、字段与方法只记录名称; 静态字段的写入与方法的调用次数记录在 Member 中供测试检查
+namespace FakeJni {
+
+enum Kind : uint8_t {
+    KIND_FREE,
+    KIND_STRING,
+    KIND_CLASS,
+    KIND_ARRAY,
+    KIND_OBJECT,
+};
+
+constexpr size_t TEXT_CAPACITY = 256;
+constexpr size_t ARRAY_CAPACITY = 8;
+constexpr size_t POOL_SIZE = 4096;
+constexpr size_t MAX_LOCALS = 8192;
+constexpr size_t MAX_FRAMES = 32;
+constexpr size_t MAX_MEMBERS = 256;
+
+struct Object {
+    Kind kind;
+    bool global;
+    jsize length;               // 字符串的字节数或数组的元素数
+    char text[TEXT_CAPACITY];   // 字符串内容, 类名, 或构造出该对象的 "类.方法"
+    Object* elements[ARRAY_CAPACITY];
+    Object* nextFree;
+};
+
+// GetStaticFieldID/GetMethodID/GetStaticMethodID 返回的字段或方法
+struct Member {
+    char className[64];
+    char name[64];
+    bool isStatic;
+    bool isField;
+    char value[TEXT_CAPACITY]; // 最近一次写入的静态字段值, 数组元素以 ',' 连接
+    int64_t number;
+    uint32_t writes;
+    uint32_t invocations;
+};
+
+inline Object pool[POOL_SIZE];
+inline size_t poolUsed = 0;
+inline Object* freeList = nullptr;
+inline Object* locals[MAX_LOCALS];
+inline size_t localCount = 0;
+inline size_t frames[MAX_FRAMES];
+inline size_t frameCount = 0;
+inline Member members[MAX_MEMBERS];
+inline size_t memberCount = 0;
+
+// 调用名为 throwingMember ("类.方法", 或 "NewStringUTF") 的方法时抛出异常并返回 null
+inline const char* throwingMember = nullptr;
+inline bool pending = false;
+// 有未处理异常时发出的 JNI 调用数; ART 的 CheckJNI 会因此中止进程, 测试断言其为 0
+inline size_t callsWithPendingException = 0;
+
+[[noreturn]] inline void fail(const char* what) {
+    fprintf(stderr, "FakeJni: %s\n", what);
+    abort();
+}
+
+inline void enter() {
+    if (pending) {
+        callsWithPendingException++;
+    }
+}
+
+inline bool shouldThrow(const char* className, const char* name) {
+    if (!throwingMember) {
+        return false;
+    }
+    std::string_view expected(throwingMember);
+    size_t classLength = strlen(className);
+    bool matches = className[0] == '\0'
+                       ? expected == name
+                       : expected.size() == classLength + 1 + strlen(name) &&
+                             expected.substr(0, classLength) == className && expected[classLength] == '.' &&
+                             expected.substr(classLength + 1) == name;
+    if (matches) {
+        pending = true;
+    }
+    return matches;
+}
+
+inline void copyText(char* target, size_t capacity, std::string_view text) {
+    if (text.size() >= capacity) {
+        fail("文本超出容量");
+    }
+    memcpy(target, text.data(), text.size());
+    target[text.size()] = '\0';
+}
+
+inline Object* allocate(Kind kind, std::string_view text, bool global) {
+    Object* object = freeList;
+    if (object) {
+        freeList = object->nextFree;
+    } else if (poolUsed < POOL_SIZE) {
+        object = &pool[poolUsed++];
+    } else {
+        fail("对象池耗尽");
+    }
+    object->kind = kind;
+    object->global = global;
+    object->length = static_cast<jsize>(text.size());
+    copyText(object->text, TEXT_CAPACITY, text);
+    object->nextFree = nullptr;
+    if (!global) {
+        if (localCount == MAX_LOCALS) {
+            fail("局部引用表溢出");
+        }
+        locals[localCount++] = object;
+    }
+    return object;
+}
+
+inline void release(Object* object) {
+    if (!object || object->kind == KIND_FREE || object->global) {
+        return;
+    }
+    object->kind = KIND_FREE;
+    object->nextFree = freeList;
+    freeList = object;
+    // 常见的创建后立即删除: 同时弹出局部引用表
+    if (localCount > 0 && locals[localCount - 1] == object) {
+        localCount--;
+    }
+}
+
+inline Object* unwrap(jobject object) {
+    return reinterpret_cast<Object*>(object);
+}
+
+inline jstring newString(std::string_view text, bool global = false) {
+    return reinterpret_cast<jstring>(allocate(KIND_STRING, text, global));
+}
+
+inline std::string_view text(jobject object) {
+    return unwrap(object)->text;
+}
+
+inline Member* findMember(std::string_view className, std::string_view name) {
+    for (size_t i = 0; i < memberCount; i++) {
+        if (className == members[i].className && name == members[i].name) {
+            return &members[i];
+        }
+    }
+    return nullptr;
+}
+
+inline Member* member(jclass clazz, const char* name, bool isStatic, bool isField) {
+    const char* className = unwrap(clazz)->text;
+    for (size_t i = 0; i < memberCount; i++) {
+        Member& existing = members[i];
+        if (existing.isStatic == isStatic && existing.isField == isField && strcmp(existing.className, className) == 0 &&
+            strcmp(existing.name, name) == 0) {
+            return &existing;
+        }
+    }
+    if (memberCount == MAX_MEMBERS) {
+        fail("字段与方法表溢出");
+    }
+    Member& created = members[memberCount++];
+    created = {};
+    copyText(created.className, sizeof(created.className), className);
+    copyText(created.name, sizeof(created.name), name);
+    created.isStatic = isStatic;
+    created.isField = isField;
+    return &created;
+}
+
+inline Member* member(jmethodID method) {
+    return reinterpret_cast<Member*>(method);
+}
+
+inline Member* member(jfieldID field) {
+    return reinterpret_cast<Member*>(field);
+}
+
+// 调用一个方法; 返回 false 表示按 throwingMember 抛出了异常
+inline bool invoke(Member* method) {
+    enter();
+    method->invocations++;
+    return !shouldThrow(method->className, method->name);
+}
+
+inline jobject newObject(Member* method) {
+    char description[TEXT_CAPACITY];
+    snprintf(description, sizeof(description), "%s.%s", method->className, method->name);
+    return reinterpret_cast<jobject>(allocate(KIND_OBJECT, description, false));
+}
+
+// 测试之间清空全部对象、字段记录与异常状态
+inline void reset() {
+    poolUsed = 0;
+    freeList = nullptr;
+    localCount = 0;
+    frameCount = 0;
+    memberCount = 0;
+    throwingMember = nullptr;
+    pending = false;
+    callsWithPendingException = 0;
+}
+
+} // namespace FakeJni
+
+inline jclass _JNIEnv::FindClass(const char* name) {
+    FakeJni::enter();
+    return reinterpret_cast<jclass>(FakeJni::allocate(FakeJni::KIND_CLASS, name, false));
+}
+
+inline jboolean _JNIEnv::ExceptionCheck() {
+    return FakeJni::pending ? JNI_TRUE : JNI_FALSE;
+}
+
+inline void _JNIEnv::ExceptionClear() {
+    FakeJni::pending = false;
+}
+
+inline void _JNIEnv::DeleteLocalRef(jobject object) {
+    FakeJni::release(FakeJni::unwrap(object));
+}
+
+inline jobject _JNIEnv::NewGlobalRef(jobject object) {
+    FakeJni::enter();
+    FakeJni::unwrap(object)->global = true;
+    return object;
+}
+
+inline jobject _JNIEnv::NewLocalRef(jobject object) {
+    FakeJni::enter();
+    return object;
+}
+
+inline void _JNIEnv::DeleteGlobalRef(jobject) {}
+
+inline jfieldID _JNIEnv::GetStaticFieldID(jclass clazz, const char* name, const char*) {
+    FakeJni::enter();
+    return reinterpret_cast<jfieldID>(FakeJni::member(clazz, name, true, true));
+}
+
+inline jmethodID _JNIEnv::GetStaticMethodID(jclass clazz, const char* name, const char*) {
+    FakeJni::enter();
+    return reinterpret_cast<jmethodID>(FakeJni::member(clazz, name, true, false));
+}
+
+inline jmethodID _JNIEnv::GetMethodID(jclass clazz, const char* name, const char*) {
+    FakeJni::enter();
+    return reinterpret_cast<jmethodID>(FakeJni::member(clazz, name, false, false));
+}
+
+inline void _JNIEnv::SetStaticObjectField(jclass, jfieldID field, jobject value) {
+    FakeJni::enter();
+    FakeJni::Member* target = FakeJni::member(field);
+    target->writes++;
+    FakeJni::Object* object = FakeJni::unwrap(value);
+    if (!object) {
+        target->value[0] = '\0';
+    } else if (object->kind == FakeJni::KIND_ARRAY) {
+        size_t length = 0;
+        for (jsize i = 0; i < object->length; i++) {
+            const char* element = object->elements[i] ? object->elements[i]->text : "";
+            length += snprintf(target->value + length, sizeof(target->value) - length, "%s%s", i ? "," : "", element);
+        }
+    } else {
+        FakeJni::copyText(target->value, sizeof(target->value), object->text);
+    }
+}
+
+inline void _JNIEnv::SetStaticIntField(jclass, jfieldID field, jint value) {
+    FakeJni::enter();
+    FakeJni::member(field)->writes++;
+    FakeJni::member(field)->number = value;
+}
+
+inline void _JNIEnv::SetStaticLongField(jclass, jfieldID field, jlong value) {
+    FakeJni::enter();
+    FakeJni::member(field)->writes++;
+    FakeJni::member(field)->number = value;
+}
+
+inline void _JNIEnv::SetStaticBooleanField(jclass, jfieldID field, jboolean value) {
+    FakeJni::enter();
+    FakeJni::member(field)->writes++;
+    FakeJni::member(field)->number = value;
+}
+
+inline jobject _JNIEnv::NewObject(jclass, jmethodID method, ...) {
+    FakeJni::Member* constructor = FakeJni::member(method);
+    return FakeJni::invoke(constructor) ? FakeJni::newObject(constructor) : nullptr;
+}
+
+inline jobject _JNIEnv::CallStaticObjectMethod(jclass, jmethodID method, ...) {
+    FakeJni::Member* target = FakeJni::member(method);
+    return FakeJni::invoke(target) ? FakeJni::newObject(target) : nullptr;
+}
+
+inline void _JNIEnv::CallStaticVoidMethod(jclass, jmethodID method, ...) {
+    FakeJni::invoke(FakeJni::member(method));
+}
+
+inline jobject _JNIEnv::CallObjectMethod(jobject, jmethodID method, ...) {
+    FakeJni::Member* target = FakeJni::member(method);
+    return FakeJni::invoke(target) ? FakeJni::newObject(target) : nullptr;
+}
+
+inline void _JNIEnv::CallVoidMethod(jobject, jmethodID method, ...) {
+    FakeJni::invoke(FakeJni::member(method));
+}
+
+inline jstring _JNIEnv::NewStringUTF(const char* utf) {
+    FakeJni::enter();
+    if (FakeJni::shouldThrow("", "NewStringUTF")) {
+        return nullptr;
+    }
+    return FakeJni::newString(utf);
+}
+
+inline jsize _JNIEnv::GetStringLength(jstring string) {
+    FakeJni::enter();
+    return FakeJni::unwrap(string)->length;
+}
+
+inline jsize _JNIEnv::GetStringUTFLength(jstring string) {
+    FakeJni::enter();
+    return FakeJni::unwrap(string)->length;
+}
+
+// 与 ART 一样返回一份需要释放的副本
+inline const char* _JNIEnv::GetStringUTFChars(jstring string, jboolean* isCopy) {
+    FakeJni::enter();
+    const FakeJni::Object* object = FakeJni::unwrap(string);
+    char* copy = new char[object->length + 1];
+    memcpy(copy, object->text, object->length + 1);
+    if (isCopy) {
+        *isCopy = JNI_TRUE;
+    }
+    return copy;
+}
+
+inline void _JNIEnv::ReleaseStringUTFChars(jstring, const char* chars) {
+    delete[] chars;
+}
+
+inline void _JNIEnv::GetStringUTFRegion(jstring string, jsize start, jsize length, char* buffer) {
+    FakeJni::enter();
+    memcpy(buffer, FakeJni::unwrap(string)->text + start, length);
+}
+
+inline jobjectArray _JNIEnv::NewObjectArray(jsize length, jclass, jobject initial) {
+    FakeJni::enter();
+    if (length < 0 || static_cast<size_t>(length) > FakeJni::ARRAY_CAPACITY) {
+        FakeJni::fail("数组超出容量");
+    }
+    FakeJni::Object* array = FakeJni::allocate(FakeJni::KIND_ARRAY, "", false);
+    array->length = length;
+    for (jsize i = 0; i < length; i++) {
+        array->elements[i] = FakeJni::unwrap(initial);
+    }
+    return reinterpret_cast<jobjectArray>(array);
+}
+
+inline void _JNIEnv::SetObjectArrayElement(jobjectArray array, jsize index, jobject value) {
+    FakeJni::enter();
+    FakeJni::Object* target = FakeJni::unwrap(array);
+    if (index < 0 || index >= target->length) {
+        FakeJni::fail("数组下标越界");
+    }
+    // 元素的内容在写入时复制, 之后删除元素的局部引用不影响数组
+    FakeJni::Object* element = FakeJni::allocate(FakeJni::KIND_STRING, FakeJni::unwrap(value)->text, true);
+    target->elements[index] = element;
+}
+
+inline jint _JNIEnv::PushLocalFrame(jint) {
+    FakeJni::enter();
+    if (FakeJni::frameCount == FakeJni::MAX_FRAMES) {
+        FakeJni::fail("局部引用帧溢出");
+    }
+    FakeJni::frames[FakeJni::frameCount++] = FakeJni::localCount;
+    return 0;
+}
+
+inline jobject _JNIEnv::PopLocalFrame(jobject) {
+    if (FakeJni::frameCount == 0) {
+        FakeJni::fail("没有可弹出的局部引用帧");
+    }
+    size_t mark = FakeJni::frames[--FakeJni::frameCount];
+    while (FakeJni::localCount > mark) {
+        FakeJni::release(FakeJni::locals[--FakeJni::localCount]);
+    }
+    return nullptr;
+}
+
+#endif // FAKE_JNI_HPP
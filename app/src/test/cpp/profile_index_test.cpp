@@ -0,0 +1,110 @@
+#include "test_support.hpp"
+#include "companion.hpp"
+
+#include <string>
+
+namespace {
+
+constexpr const char* FULL_INDEX_FILE = "profile_index_test.bin";
+
+json makeProfile(const char* name, std::initializer_list<const char*> targets) {
+    json profile = {{"name", name}, {"targets", json::array()}};
+    for (const char* target : targets) {
+        profile["targets"].push_back(target);
+    }
+    return profile;
+}
+
+// 从完整索引重新生成的 target 索引与直接编译的 target 索引匹配结果一致, 且不含 build 字段与响应数据
+void testExtractTargetIndex() {
+    Companion::ClassifiedProfile classified;
+    classified.buildFields.push_back({BuildFields::find("MODEL"), "SecretModel", 0, 0});
+    json profiles[] = {makeProfile("exact", {"com.example.app", "com.other"}),
+                       makeProfile("prefix", {"com.vendor.*"}),
+                       makeProfile("suffix", {"*:remote"})};
+
+    Companion::IndexBuilder builder;
+    Companion::IndexBuilder targetBuilder(true);
+    for (const json& profile : profiles) {
+        builder.addProfile(profile, classified);
+        targetBuilder.addProfile(profile, classified);
+    }
+    std::vector<uint8_t> full = builder.finish(42);
+    std::vector<uint8_t> compiled = targetBuilder.finish(42);
+    CHECK(Companion::writeIndexFile(FULL_INDEX_FILE, "profile_index_test.bin.tmp", full));
+
+    ProfileIndex::MappedFile mapped;
+    CHECK(mapped.map(FULL_INDEX_FILE));
+    unlink(FULL_INDEX_FILE);
+    std::vector<uint8_t> extracted = Companion::extractTargetIndex(mapped);
+
+    ProfileIndex::View expected;
+    ProfileIndex::View actual;
+    CHECK(expected.attach(compiled.data(), compiled.size()));
+    CHECK(actual.attach(extracted.data(), extracted.size()));
+    CHECK(actual.header().flags & ProfileIndex::INDEX_FLAG_TARGETS_ONLY);
+    CHECK(actual.header().sourceWriteTime == 42);
+    CHECK(actual.header().fieldCount == 0 && actual.header().responseSize == 0);
+    CHECK(std::string_view(reinterpret_cast<const char*>(extracted.data()), extracted.size()).find("SecretModel") ==
+          std::string_view::npos);
+
+    for (const char* process : {"com.example.app", "com.other", "com.vendor.camera", "com.app:remote",
+                                "com.vendor.x:remote", "com.unknown", "com.example"}) {
+        const ProfileIndex::ProfileRecord* want = expected.findProfile(process);
+        const ProfileIndex::ProfileRecord* got = actual.findProfile(process);
+        CHECK((want == nullptr) == (got == nullptr));
+        if (want) {
+            CHECK(expected.string(want->name) == actual.string(got->name));
+        }
+    }
+}
+
+// 匹配优先级: 精确匹配 > 字面部分更长的模式 > 长度相同时前缀模式优先; 同名精确 target 以后出现的 profile 为准
+void testTargetPriority() {
+    Companion::ClassifiedProfile classified;
+    json profiles[] = {makeProfile("exact", {"com.vendor.app", "com.dup"}),
+                       makeProfile("shortPrefix", {"com.*"}),
+                       makeProfile("longPrefix", {"com.vendor.*"}),
+                       makeProfile("remoteSuffix", {"*:remote"}),
+                       makeProfile("tiePrefix", {"abc.*"}),
+                       makeProfile("tieSuffix", {"*.xyz"}),
+                       makeProfile("catchAll", {"*"}),
+                       makeProfile("unsupported", {"com.*.app"}),
+                       makeProfile("laterDup", {"com.dup"})};
+    Companion::IndexBuilder builder;
+    for (const json& profile : profiles) {
+        builder.addProfile(profile, classified);
+    }
+    std::vector<uint8_t> image = builder.finish(1);
+    ProfileIndex::View index;
+    CHECK(index.attach(image.data(), image.size()));
+
+    auto winner = [&](std::string_view process) {
+        const ProfileIndex::ProfileRecord* record = index.findProfile(process);
+        return record ? index.string(record->name) : std::string_view("<none>");
+    };
+    // 精确匹配优先于同样命中的前缀模式
+    CHECK(winner("com.vendor.app") == "exact");
+    // 两个前缀模式取字面部分更长的
+    CHECK(winner("com.vendor.camera") == "longPrefix");
+    CHECK(winner("com.other") == "shortPrefix");
+    // 前缀与后缀都命中时按字面长度: "com.vendor." (11) > ":remote" (7) > "com." (4)
+    CHECK(winner("com.vendor.camera:remote") == "longPrefix");
+    CHECK(winner("com.other:remote") == "remoteSuffix");
+    // 字面长度相同 ("abc." 与 ".xyz") 时前缀优先
+    CHECK(winner("abc.mid.xyz") == "tiePrefix");
+    CHECK(winner("def.xyz") == "tieSuffix");
+    // 空字面的 "*" 只在没有其他模式命中时生效
+    CHECK(winner("unrelated") == "catchAll");
+    CHECK(winner("com.dup") == "laterDup");
+    // 不支持的模式被忽略, 不会按字面名称匹配
+    CHECK(winner("com.*.app") == "shortPrefix");
+}
+
+} // namespace
+
+int main() {
+    testExtractTargetIndex();
+    testTargetPriority();
+    return 0;
+}
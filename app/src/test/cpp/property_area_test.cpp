@@ -0,0 +1,188 @@
+#include "test_support.hpp"
+#include "property_fixture.hpp"
+
+#include <sys/mman.h>
+
+using namespace PropertyArea;
+
+namespace {
+
+const uint32_t PAGE_SIZE_BYTES = static_cast<uint32_t>(sysconf(_SC_PAGESIZE));
+
+const ProfilePayload::PropertyEntry* entryAt(const uint8_t* area, size_t size, const char* name) {
+    uint32_t offset = AreaReader(area, size).findProperty(name);
+    return offset ? reinterpret_cast<const ProfilePayload::PropertyEntry*>(area + offset) : nullptr;
+}
+
+// 把镜像中的页面按目录贴回属性区副本, 模拟 app 进程中 MAP_FIXED 之后看到的内容
+std::vector<uint8_t> applyImage(const OverlayView& overlay, const uint8_t* image, const OverlayArea& record,
+                                const AreaWriter& area) {
+    std::vector<uint8_t> patched(area.data(), area.data() + area.size());
+    for (uint32_t i = record.firstPage; i < record.firstPage + record.pageCount; i++) {
+        const OverlayPage& page = overlay.page(i);
+        memcpy(patched.data() + page.areaOffset, image + page.imageOffset, PAGE_SIZE_BYTES);
+    }
+    return patched;
+}
+
+Companion::ClassifiedProfile makeProfile(std::initializer_list<std::pair<const char*, const char*>> properties) {
+    Companion::ClassifiedProfile classified;
+    classified.propertyOverlay = true;
+    for (const auto& [name, value] : properties) {
+        classified.properties[name] = value;
+    }
+    return classified;
+}
+
+// 只含 ro.* 的属性区: 被覆盖属性所在的页面写入伪装值, 序号保留, 其余页面不进入镜像
+void testPatchesReadOnlyArea() {
+    AreaWriter area;
+    for (int i = 0; i < 300; i++) {
+        area.add("ro.build.pad." + std::to_string(i), "x");
+    }
+    uint32_t modelOffset = area.add("ro.product.model", "RealPhone");
+    area.add("ro.build.fingerprint", "real/fingerprint");
+    reinterpret_cast<ProfilePayload::PropertyEntry*>(area.data() + modelOffset)->serial |= 6;
+
+    ProfileFixture profile = buildProfile(makeProfile({{"ro.product.model", "Pixel 9"},
+                                                       {"ro.build.fingerprint", "google/x/y:15/AP/1:user/release-keys"},
+                                                       {"ro.not.present", "m"}}));
+    OverlayBuilder builder(profile.view, PAGE_SIZE_BYTES);
+    builder.addArea("u:object_r:build_prop:s0", area.data(), area.size());
+    CHECK(builder.coveredCount() == 2);
+
+    std::vector<uint8_t> image = builder.finish();
+    OverlayView overlay;
+    CHECK(overlay.attach(image.data(), image.size()));
+    CHECK(overlay.header().areaCount == 1 && overlay.header().coveredCount == 2);
+    CHECK(overlay.findArea("u:object_r:build_prop:s0") == 0 && overlay.findArea("other") < 0);
+    const OverlayArea& record = overlay.area(0);
+    CHECK(record.bytesUsed == area.header().bytesUsed && record.areaSize == area.size());
+    CHECK(record.pageCount >= 1 && record.pageCount <= 2);
+
+    std::vector<uint8_t> patched = applyImage(overlay, image.data(), record, area);
+    const ProfilePayload::PropertyEntry* model = entryAt(patched.data(), patched.size(), "ro.product.model");
+    CHECK(model && strcmp(model->value, "Pixel 9") == 0);
+    CHECK(model->serial == ((7u << 24) | 6));
+    const ProfilePayload::PropertyEntry* fingerprint = entryAt(patched.data(), patched.size(), "ro.build.fingerprint");
+    CHECK(fingerprint && strcmp(fingerprint->value, "google/x/y:15/AP/1:user/release-keys") == 0);
+    const ProfilePayload::PropertyEntry* pad = entryAt(patched.data(), patched.size(), "ro.build.pad.17");
+    CHECK(pad && strcmp(pad->value, "x") == 0);
+
+    // 除被改写的两个取值外, 属性区其余字节不变
+    size_t changed = 0;
+    for (size_t i = 0; i < patched.size(); i++) {
+        changed += patched[i] != area.data()[i];
+    }
+    CHECK(changed > 0 && changed <= 2 * sizeof(ProfilePayload::PropertyEntry));
+}
+
+// 可变属性 (非 ro.*) 所在的页面与 dirty backup 区所在的首页不能覆盖; 同一属性区中其他页面上的属性仍可覆盖
+void testRejectsMutablePages() {
+    AreaWriter area;
+    int padding = 0;
+    auto padToPage = [&](uint32_t page) {
+        while (sizeof(AreaHeader) + area.header().bytesUsed < page * PAGE_SIZE_BYTES + 64) {
+            area.add("ro.pad." + std::to_string(padding++), "x");
+        }
+    };
+    // 首页只有 ro.* 属性, 但属性区中存在可变属性, 首页的 dirty backup 区可能被改写
+    area.add("ro.early", "real");
+    padToPage(2);
+    uint32_t sharedOffset = area.add("ro.shared", "real");
+    uint32_t mutableOffset = area.add("vendor.late.flag", "b");
+    padToPage(3);
+    uint32_t lateOffset = area.add("ro.late", "real");
+    CHECK(sharedOffset / PAGE_SIZE_BYTES == 2 && mutableOffset / PAGE_SIZE_BYTES == 2);
+    CHECK(lateOffset / PAGE_SIZE_BYTES == 3);
+
+    ProfileFixture profile =
+        buildProfile(makeProfile({{"ro.early", "spoof"}, {"ro.shared", "spoof"}, {"ro.late", "spoof"}}));
+    OverlayBuilder builder(profile.view, PAGE_SIZE_BYTES);
+    builder.addArea("u:object_r:default_prop:s0", area.data(), area.size());
+    CHECK(builder.coveredCount() == 1);
+
+    std::vector<uint8_t> image = builder.finish();
+    OverlayView overlay;
+    CHECK(overlay.attach(image.data(), image.size()));
+    const OverlayArea& record = overlay.area(0);
+    CHECK(record.pageCount == 1 && overlay.page(record.firstPage).areaOffset == 3 * PAGE_SIZE_BYTES);
+    std::vector<uint8_t> patched = applyImage(overlay, image.data(), record, area);
+    CHECK(strcmp(entryAt(patched.data(), patched.size(), "ro.late")->value, "spoof") == 0);
+    CHECK(strcmp(entryAt(patched.data(), patched.size(), "ro.shared")->value, "real") == 0);
+    CHECK(strcmp(entryAt(patched.data(), patched.size(), "ro.early")->value, "real") == 0);
+
+    // 唯一的被覆盖属性与可变属性同页时不生成镜像
+    AreaWriter mixed;
+    mixed.add("ro.mixed.flag", "1");
+    mixed.add("persist.sys.x", "a");
+    ProfileFixture mixedProfile = buildProfile(makeProfile({{"ro.mixed.flag", "0"}}));
+    OverlayBuilder mixedBuilder(mixedProfile.view, PAGE_SIZE_BYTES);
+    mixedBuilder.addArea("u:object_r:mixed_prop:s0", mixed.data(), mixed.size());
+    CHECK(mixedBuilder.coveredCount() == 0 && mixedBuilder.finish().empty());
+}
+
+// 镜像经 memfd 以 MAP_FIXED 贴到属性区映射上; 快照之后新增过属性的属性区以 bytesUsed 识别并放弃
+void testMapsPagesAndRejectsChangedArea() {
+    AreaWriter area;
+    for (int i = 0; i < 200; i++) {
+        area.add("ro.vendor.pad." + std::to_string(i), "x");
+    }
+    area.add("ro.product.board", "real");
+    ProfileFixture profile = buildProfile(makeProfile({{"ro.product.board", "tensor"}}));
+    OverlayBuilder builder(profile.view, PAGE_SIZE_BYTES);
+    builder.addArea("u:object_r:vendor_prop:s0", area.data(), area.size());
+    std::vector<uint8_t> image = builder.finish();
+    OverlayView overlay;
+    CHECK(overlay.attach(image.data(), image.size()));
+    const OverlayArea& record = overlay.area(0);
+
+    int fd = createMemfd("property_area_test", MFD_CLOEXEC);
+    CHECK(fd >= 0 && safeWrite(fd, image.data(), image.size()));
+    void* memory = mmap(nullptr, area.size(), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    CHECK(memory != MAP_FAILED);
+    auto* mapping = static_cast<uint8_t*>(memory);
+    memcpy(mapping, area.data(), area.size());
+
+    CHECK(matchesSnapshot(record, mapping));
+    CHECK(mapAreaPages(overlay, record, mapping, fd, 0));
+    CHECK(strcmp(entryAt(mapping, area.size(), "ro.product.board")->value, "tensor") == 0);
+    CHECK(strcmp(entryAt(mapping, area.size(), "ro.vendor.pad.3")->value, "x") == 0);
+    munmap(memory, area.size());
+    close(fd);
+
+    area.add("ro.vendor.added", "late");
+    CHECK(!matchesSnapshot(record, area.data()));
+    area.header().magic = 0;
+    CHECK(!matchesSnapshot(record, area.data()));
+}
+
+// 损坏的目录在 attach 时被拒绝
+void testRejectsCorruptDirectory() {
+    AreaWriter area;
+    area.add("ro.product.name", "real");
+    ProfileFixture profile = buildProfile(makeProfile({{"ro.product.name", "spoof"}}));
+    OverlayBuilder builder(profile.view, PAGE_SIZE_BYTES);
+    builder.addArea("u:object_r:product_prop:s0", area.data(), area.size());
+    std::vector<uint8_t> image = builder.finish();
+    OverlayView overlay;
+    CHECK(overlay.attach(image.data(), image.size()));
+    CHECK(!overlay.attach(image.data(), PAGE_SIZE_BYTES));
+
+    std::vector<uint8_t> corrupt = image;
+    reinterpret_cast<OverlayHeader*>(corrupt.data())->coveredCount++;
+    CHECK(!overlay.attach(corrupt.data(), corrupt.size()));
+    corrupt = image;
+    reinterpret_cast<OverlayArea*>(corrupt.data() + sizeof(OverlayHeader))->pageCount = 2;
+    CHECK(!overlay.attach(corrupt.data(), corrupt.size()));
+}
+
+} // namespace
+
+int main() {
+    testPatchesReadOnlyArea();
+    testRejectsMutablePages();
+    testMapsPagesAndRejectsChangedArea();
+    testRejectsCorruptDirectory();
+    return 0;
+}
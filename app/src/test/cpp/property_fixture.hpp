@@ -0,0 +1,178 @@
+#ifndef PROPERTY_FIXTURE_HPP
+#define PROPERTY_FIXTURE_HPP
+
+#include "test_support.hpp"
+#include "companion.hpp"
+#include "property_area.hpp"
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+// 属性相关主机测试与基准的共用夹具: 按 bionic 布局在内存中构造的属性区, 以及编译好的 profile 记录
+
+// 与 bionic 的 prop_area::add 相同地插入属性: 名称按 '.' 分段, 同层节点是按 compareSegment 排序的
+// 二叉搜索树, 根节点之后预留 dirty backup 区. 只追加, 不回收
+class AreaWriter {
+public:
+    explicit AreaWriter(size_t size = 128 * 1024) : area(size, 0) {
+        auto& header = this->header();
+        header.magic = PropertyArea::AREA_MAGIC;
+        header.version = PropertyArea::AREA_VERSION;
+        header.bytesUsed = sizeof(PropertyArea::TrieNode) + PROP_VALUE_MAX;
+    }
+
+    // 返回 prop_info 相对于属性区起始的偏移
+    uint32_t add(std::string_view name, std::string_view value) {
+        CHECK(value.size() < PROP_VALUE_MAX);
+        uint32_t current = 0;
+        std::string_view rest = name;
+        while (true) {
+            size_t separator = rest.find('.');
+            current = findOrAdd(&node(current)->children, rest.substr(0, separator));
+            if (separator == std::string_view::npos) {
+                break;
+            }
+            rest.remove_prefix(separator + 1);
+        }
+        uint32_t offset = allocate(sizeof(ProfilePayload::PropertyEntry) + name.size() + 1);
+        auto* entry = reinterpret_cast<ProfilePayload::PropertyEntry*>(body() + offset);
+        entry->serial = static_cast<uint32_t>(value.size()) << 24;
+        memcpy(entry->value, value.data(), value.size());
+        memcpy(reinterpret_cast<char*>(entry + 1), name.data(), name.size());
+        node(current)->prop = offset;
+        return static_cast<uint32_t>(sizeof(PropertyArea::AreaHeader) + offset);
+    }
+
+    PropertyArea::AreaHeader& header() { return *reinterpret_cast<PropertyArea::AreaHeader*>(area.data()); }
+    uint8_t* data() { return area.data(); }
+    const uint8_t* data() const { return area.data(); }
+    size_t size() const { return area.size(); }
+
+private:
+    std::vector<uint8_t> area;
+
+    uint8_t* body() { return area.data() + sizeof(PropertyArea::AreaHeader); }
+    PropertyArea::TrieNode* node(uint32_t offset) { return reinterpret_cast<PropertyArea::TrieNode*>(body() + offset); }
+
+    uint32_t allocate(size_t length) {
+        length = (length + 3) & ~size_t(3);
+        uint32_t offset = header().bytesUsed;
+        CHECK(sizeof(PropertyArea::AreaHeader) + offset + length <= area.size());
+        header().bytesUsed += static_cast<uint32_t>(length);
+        return offset;
+    }
+
+    uint32_t findOrAdd(uint32_t* slot, std::string_view segment) {
+        while (*slot) {
+            PropertyArea::TrieNode* current = node(*slot);
+            int order = PropertyArea::compareSegment(segment, current);
+            if (order == 0) {
+                return *slot;
+            }
+            slot = order < 0 ? &current->left : &current->right;
+        }
+        // 属性区大小固定, slot 在分配后仍然有效
+        uint32_t offset = allocate(sizeof(PropertyArea::TrieNode) + segment.size() + 1);
+        PropertyArea::TrieNode* created = node(offset);
+        created->nameLength = static_cast<uint32_t>(segment.size());
+        memcpy(reinterpret_cast<char*>(created + 1), segment.data(), segment.size());
+        *slot = offset;
+        return offset;
+    }
+};
+
+// 约 1500 个属性, 名称分布大致仿照真机 (ro.* 为主, 另有 persist/vendor/init.svc 等可变属性); 返回写入的名称
+inline std::vector<std::string> fillTypicalProperties(AreaWriter& writer, size_t count = 1500) {
+    static constexpr const char* PREFIXES[] = {"ro.build.",  "ro.product.", "ro.vendor.", "ro.boot.",
+                                               "ro.hardware.", "persist.sys.", "vendor.",   "init.svc.",
+                                               "dalvik.vm.", "sys.",         "ro.surface_flinger.", "debug."};
+    std::vector<std::string> names;
+    for (size_t i = 0; i < count; i++) {
+        names.push_back(std::string(PREFIXES[i % std::size(PREFIXES)]) + "prop" + std::to_string(i));
+        writer.add(names.back(), "value" + std::to_string(i));
+    }
+    return names;
+}
+
+// 主机上代替 bionic 读取单个属性区: 查找与 libc 一样走 trie, 枚举与 bionic 的 foreach_property 一样递归遍历.
+// 不包含 bionic 按 property_contexts 选择属性区的前缀匹配, 因此略快于真机上的原函数
+namespace StockProperties {
+
+using ForeachCallback = void (*)(const prop_info* pi, void* cookie);
+
+inline const uint8_t* area = nullptr;
+inline size_t areaSize = 0;
+
+inline const prop_info* find(const char* name) {
+    uint32_t offset = PropertyArea::AreaReader(area, areaSize).findProperty(name);
+    return offset ? reinterpret_cast<const prop_info*>(area + offset) : nullptr;
+}
+
+inline int get(const char* name, char* value) {
+    const auto* entry = reinterpret_cast<const ProfilePayload::PropertyEntry*>(find(name));
+    if (!entry) {
+        value[0] = '\0';
+        return 0;
+    }
+    uint32_t length = ProfilePayload::propertyValueLength(entry);
+    memcpy(value, entry->value, length + 1);
+    return static_cast<int>(length);
+}
+
+inline void visit(uint32_t offset, ForeachCallback callback, void* cookie) {
+    const auto* node = reinterpret_cast<const PropertyArea::TrieNode*>(area + sizeof(PropertyArea::AreaHeader) + offset);
+    if (node->left) {
+        visit(node->left, callback, cookie);
+    }
+    if (node->prop) {
+        callback(reinterpret_cast<const prop_info*>(area + sizeof(PropertyArea::AreaHeader) + node->prop), cookie);
+    }
+    if (node->children) {
+        visit(node->children, callback, cookie);
+    }
+    if (node->right) {
+        visit(node->right, callback, cookie);
+    }
+}
+
+inline int foreach(ForeachCallback callback, void* cookie) {
+    visit(0, callback, cookie);
+    return 0;
+}
+
+inline void attach(const AreaWriter& writer) {
+    area = writer.data();
+    areaSize = writer.size();
+}
+
+} // namespace StockProperties
+
+// Companion 为一个 profile 编译出的配置记录, 复制到 8 字节对齐的缓冲区后 attach
+struct ProfileFixture {
+    std::vector<uint64_t> payload;
+    ProfilePayload::View view;
+};
+
+inline ProfileFixture buildProfile(const Companion::ClassifiedProfile& classified) {
+    json profile = {{"name", "fixture"}, {"targets", {"com.example.app"}}};
+    Companion::IndexBuilder builder;
+    builder.addProfile(profile, classified);
+    std::vector<uint8_t> index = builder.finish(1);
+
+    ProfileIndex::View indexView;
+    CHECK(indexView.attach(index.data(), index.size()));
+    const ProfileIndex::ProfileRecord* record = indexView.findProfile("com.example.app");
+    CHECK(record != nullptr);
+    Protocol::ResponseHeader response;
+    memcpy(&response, indexView.response(*record), sizeof(response));
+    CHECK(Protocol::isValidResponse(response));
+
+    ProfileFixture fixture;
+    fixture.payload.resize((response.payloadSize + 7) / 8);
+    memcpy(fixture.payload.data(), indexView.response(*record) + sizeof(response), response.payloadSize);
+    CHECK(fixture.view.attach(reinterpret_cast<const uint8_t*>(fixture.payload.data()), response.payloadSize));
+    return fixture;
+}
+
+#endif // PROPERTY_FIXTURE_HPP
@@ -0,0 +1,64 @@
+#include "test_support.hpp"
+#include "bench_support.hpp"
+#include "property_fixture.hpp"
+#include "property_hooks.hpp"
+
+// __system_property_foreach: 枚举约 1500 个属性时原函数与 hook 之后的开销对比.
+// hook 对每条记录做一次哈希探测, 被覆盖的属性换成记录中的条目, 最后补充系统中不存在的被覆盖属性
+extern "C" const prop_info* __system_property_find(const char* name) {
+    return StockProperties::find(name);
+}
+
+namespace {
+
+constexpr size_t OVERRIDE_COUNT = 40;
+
+struct Visited {
+    size_t count = 0;
+    size_t spoofed = 0;
+    size_t valueBytes = 0;
+};
+
+// 与常见的枚举方 (getprop 等) 一样读取每条记录的名称与取值
+void visit(const prop_info* pi, void* cookie) {
+    auto* visited = static_cast<Visited*>(cookie);
+    const auto* entry = reinterpret_cast<const ProfilePayload::PropertyEntry*>(pi);
+    visited->count++;
+    visited->valueBytes += strlen(entry->value) + strlen(ProfilePayload::propertyName(entry));
+    visited->spoofed += strncmp(entry->value, "spoofed", 7) == 0;
+}
+
+} // namespace
+
+int main() {
+    AreaWriter area(512 * 1024);
+    std::vector<std::string> all = fillTypicalProperties(area);
+    StockProperties::attach(area);
+
+    Companion::ClassifiedProfile classified;
+    for (size_t k = 0; k < OVERRIDE_COUNT; k++) {
+        classified.properties[all[k * (all.size() / OVERRIDE_COUNT)]] = "spoofed" + std::to_string(k);
+    }
+    classified.properties["ro.spoof.only"] = "spoofed";
+    ProfileFixture profile = buildProfile(classified);
+
+    PropertyHooks::overrides = profile.view;
+    PropertyHooks::collectExtraEntries();
+    PropertyHooks::originalForeach = StockProperties::foreach;
+    CHECK(PropertyHooks::extraEntryCount == 1);
+
+    Visited stock;
+    CHECK(StockProperties::foreach(visit, &stock) == 0);
+    CHECK(stock.count == all.size() && stock.spoofed == 0);
+    Visited hooked;
+    CHECK(PropertyHooks::hookedForeach(visit, &hooked) == 0);
+    CHECK(hooked.count == all.size() + 1 && hooked.spoofed == OVERRIDE_COUNT + 1);
+
+    size_t iterations = benchIterations(1000);
+    Visited sink;
+    double plain = measure("原函数枚举", iterations, [&](size_t) { StockProperties::foreach(visit, &sink); });
+    double spoofed = measure("hook 后枚举", iterations, [&](size_t) { PropertyHooks::hookedForeach(visit, &sink); });
+    keep(sink);
+    fprintf(stderr, "%10.1f ns/条  hook 增加的开销\n", (spoofed - plain) / static_cast<double>(all.size()));
+    return 0;
+}
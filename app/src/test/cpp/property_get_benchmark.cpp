@@ -0,0 +1,69 @@
+#include "test_support.hpp"
+#include "bench_support.hpp"
+#include "property_fixture.hpp"
+#include "property_hooks.hpp"
+
+// __system_property_get: 原函数 (在合成属性区中查找) 与 hook 之后命中/未命中覆盖表的开销对比.
+// hook 未命中时只比原函数多一次哈希探测
+namespace {
+
+constexpr size_t OVERRIDE_COUNT = 40;
+
+struct Names {
+    std::vector<std::string> overridden;
+    std::vector<std::string> untouched;
+};
+
+Names prepare(AreaWriter& area, Companion::ClassifiedProfile& classified) {
+    std::vector<std::string> all = fillTypicalProperties(area);
+    Names names;
+    // 均匀取 OVERRIDE_COUNT 个覆盖, 其余作为未命中
+    for (size_t i = 0; i < all.size(); i++) {
+        const std::string& name = all[i];
+        if (i % (all.size() / OVERRIDE_COUNT) == 0 && names.overridden.size() < OVERRIDE_COUNT) {
+            classified.properties[name] = "spoofed" + std::to_string(i);
+            names.overridden.push_back(name);
+        } else {
+            names.untouched.push_back(name);
+        }
+    }
+    return names;
+}
+
+} // namespace
+
+int main() {
+    AreaWriter area(512 * 1024);
+    Companion::ClassifiedProfile classified;
+    Names names = prepare(area, classified);
+    StockProperties::attach(area);
+    ProfileFixture profile = buildProfile(classified);
+    PropertyHooks::overrides = profile.view;
+    PropertyHooks::originalGet = StockProperties::get;
+
+    char value[PROP_VALUE_MAX];
+    CHECK(PropertyHooks::hookedGet(names.overridden[1].c_str(), value) > 0 && strncmp(value, "spoofed", 7) == 0);
+    CHECK(PropertyHooks::hookedGet(names.untouched[1].c_str(), value) > 0 && strncmp(value, "value", 5) == 0);
+    CHECK(PropertyHooks::hookedGet("ro.does.not.exist", value) == 0 && value[0] == '\0');
+
+    size_t iterations = benchIterations(50000);
+    const std::vector<std::string>& hits = names.overridden;
+    const std::vector<std::string>& misses = names.untouched;
+    measure("原函数 (被覆盖的键)", iterations, [&](size_t i) {
+        keep(StockProperties::get(hits[i % hits.size()].c_str(), value));
+    });
+    measure("hook 命中", iterations, [&](size_t i) {
+        keep(PropertyHooks::hookedGet(hits[i % hits.size()].c_str(), value));
+    });
+    measure("原函数 (未覆盖的键)", iterations, [&](size_t i) {
+        keep(StockProperties::get(misses[i % misses.size()].c_str(), value));
+    });
+    measure("hook 未命中", iterations, [&](size_t i) {
+        keep(PropertyHooks::hookedGet(misses[i % misses.size()].c_str(), value));
+    });
+    measure("原函数 (不存在的键)", iterations, [&](size_t) { keep(StockProperties::get("ro.does.not.exist", value)); });
+    measure("hook 未命中 (不存在的键)", iterations, [&](size_t) {
+        keep(PropertyHooks::hookedGet("ro.does.not.exist", value));
+    });
+    return 0;
+}
@@ -0,0 +1,128 @@
+#include "test_support.hpp"
+#include "snapshot_store.hpp"
+
+#include <thread>
+#include <vector>
+
+// 逐步执行 SnapshotStore::read 的各个步骤, 以便在步骤之间插入写者
+struct SnapshotStoreTestAccess {
+    template <class T>
+    static uint32_t loadParity(const SnapshotStore<T>& store) {
+        return store.epoch.load(std::memory_order_seq_cst) & 1;
+    }
+
+    template <class T>
+    static const T* enter(const SnapshotStore<T>& store, uint32_t parity) {
+        store.readers[parity].count.fetch_add(1, std::memory_order_seq_cst);
+        return store.current.load(std::memory_order_seq_cst);
+    }
+
+    template <class T>
+    static void leave(const SnapshotStore<T>& store, uint32_t parity) {
+        store.readers[parity].count.fetch_sub(1, std::memory_order_release);
+    }
+};
+
+namespace {
+
+constexpr uint32_t MAX_SNAPSHOTS = 1u << 20;
+// 已回收的快照在此标记; 数组本身不回收, 读者持有已被释放的快照时可以可靠地发现
+std::atomic<bool> alive[MAX_SNAPSHOTS];
+
+struct Snapshot {
+    explicit Snapshot(uint32_t id) : id(id) { alive[id].store(true, std::memory_order_relaxed); }
+    ~Snapshot() { alive[id].store(false, std::memory_order_release); }
+    uint32_t id;
+};
+
+void testPublishAndRead() {
+    SnapshotStore<Snapshot> store;
+    CHECK(!store.read());
+    CHECK(store.currentGeneration() == 0);
+
+    store.publish(std::make_unique<Snapshot>(1));
+    {
+        auto guard = store.read();
+        CHECK(guard && guard->id == 1);
+    }
+    store.publish(std::make_unique<Snapshot>(2));
+    CHECK(!alive[1].load());
+    CHECK(store.read()->id == 2);
+    CHECK(store.currentGeneration() == 2);
+}
+
+// 读者读取奇偶位后被抢占, 期间写者发布一次; 读者随后登记在已翻转过去的奇偶位上并取得新快照.
+// 下一次发布不得在读者离开前回收这份快照
+void testReaderPreemptedBeforeRegistering() {
+    SnapshotStore<Snapshot> store;
+    store.publish(std::make_unique<Snapshot>(3));
+
+    uint32_t parity = SnapshotStoreTestAccess::loadParity(store);
+    store.publish(std::make_unique<Snapshot>(4));
+    const Snapshot* held = SnapshotStoreTestAccess::enter(store, parity);
+    CHECK(held->id == 4);
+    CHECK(!alive[3].load());
+
+    std::atomic<bool> published{false};
+    std::thread writer([&] {
+        store.publish(std::make_unique<Snapshot>(5));
+        published.store(true);
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    CHECK(alive[4].load());
+    CHECK(!published.load());
+
+    SnapshotStoreTestAccess::leave(store, parity);
+    writer.join();
+    CHECK(!alive[4].load());
+    CHECK(store.read()->id == 5);
+}
+
+// 读者不断查询并在持有期间反复确认快照未被回收, 写者同时不断发布新快照
+void testLookupsDuringReload() {
+    SnapshotStore<Snapshot> store;
+    uint32_t nextId = 10;
+    store.publish(std::make_unique<Snapshot>(nextId++));
+
+    std::atomic<bool> stop{false};
+    std::atomic<uint64_t> lookups{0};
+    std::atomic<uint64_t> violations{0};
+    std::vector<std::thread> readers;
+    for (int i = 0; i < 4; i++) {
+        readers.emplace_back([&] {
+            while (!stop.load(std::memory_order_relaxed)) {
+                auto guard = store.read();
+                uint32_t id = guard->id;
+                for (int check = 0; check < 8; check++) {
+                    if (id >= MAX_SNAPSHOTS || !alive[id].load(std::memory_order_acquire)) {
+                        violations.fetch_add(1, std::memory_order_relaxed);
+                        break;
+                    }
+                    std::this_thread::yield();
+                }
+                lookups.fetch_add(1, std::memory_order_relaxed);
+            }
+        });
+    }
+
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+    while (std::chrono::steady_clock::now() < deadline && nextId < MAX_SNAPSHOTS) {
+        store.publish(std::make_unique<Snapshot>(nextId++));
+    }
+    stop.store(true);
+    for (std::thread& reader : readers) {
+        reader.join();
+    }
+    fprintf(stderr, "发布 %u 次, 查询 %llu 次\n", nextId - 10, static_cast<unsigned long long>(lookups.load()));
+    CHECK(violations.load() == 0);
+    CHECK(lookups.load() > 0);
+}
+
+} // namespace
+
+int main() {
+    testPublishAndRead();
+    testReaderPreemptedBeforeRegistering();
+    testLookupsDuringReload();
+    return 0;
+}
@@ -0,0 +1,441 @@
+#include "test_support.hpp"
+#include "fake_jni.hpp"
+#include "property_fixture.hpp"
+
+// 模块本身: 测试通过 zygisk_module_entry 与注册的 module_abi 驱动, 与 Zygisk 的调用方式相同
+#include "main.cpp"
+
+#include <malloc.h>
+
+// 计数分配器: 替换 glibc 的 malloc 系列 (operator new 也经由 malloc), 只计 counting 置位的线程.
+// Companion 在另一个线程中应答, 与真机上一样在另一个进程中分配, 不计入
+extern "C" {
+void* __libc_malloc(size_t);
+void* __libc_calloc(size_t, size_t);
+void* __libc_realloc(void*, size_t);
+void* __libc_memalign(size_t, size_t);
+void __libc_free(void*);
+}
+
+namespace {
+thread_local bool counting = false;
+size_t allocations = 0;
+
+void countAllocation() {
+    if (counting) {
+        allocations++;
+    }
+}
+
+// Zygisk 自身的工作 (如 connectCompanion) 不属于模块, 执行期间暂停计数
+class PauseCounting {
+public:
+    PauseCounting() : saved(counting) { counting = false; }
+    ~PauseCounting() { counting = saved; }
+
+private:
+    bool saved;
+};
+} // namespace
+
+extern "C" {
+void* malloc(size_t size) {
+    countAllocation();
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size) {
+    countAllocation();
+    return __libc_calloc(count, size);
+}
+
+void* realloc(void* pointer, size_t size) {
+    countAllocation();
+    return __libc_realloc(pointer, size);
+}
+
+void* memalign(size_t alignment, size_t size) {
+    countAllocation();
+    return __libc_memalign(alignment, size);
+}
+
+void* aligned_alloc(size_t alignment, size_t size) {
+    countAllocation();
+    return __libc_memalign(alignment, size);
+}
+
+int posix_memalign(void** result, size_t alignment, size_t size) {
+    countAllocation();
+    *result = __libc_memalign(alignment, size);
+    return *result ? 0 : ENOMEM;
+}
+
+void free(void* pointer) {
+    __libc_free(pointer);
+}
+
+// app 进程中的系统属性由合成的属性区提供
+int __system_property_get(const char* name, char* value) {
+    return StockProperties::get(name, value);
+}
+
+const prop_info* __system_property_find(const char* name) {
+    return StockProperties::find(name);
+}
+}
+
+// 最小的 Zygisk: 记录模块的调用, connectCompanion 连接到在线程中运行的真实 Companion 处理函数
+namespace FakeZygisk {
+
+zygisk::internal::module_abi* module = nullptr;
+int moduleDirFd = -1;
+std::thread companion;
+int companionFd = -1;
+bool connected = false;
+bool dlcloseRequested = false;
+size_t pltRegistrations = 0;
+size_t jniHooks = 0;
+size_t exemptedFds = 0;
+
+bool registerModule(zygisk::internal::api_table*, zygisk::internal::module_abi* abi) {
+    module = abi;
+    return true;
+}
+
+void hookJniNativeMethods(JNIEnv*, const char*, JNINativeMethod*, int count) {
+    jniHooks += count;
+}
+
+bool exemptFd(int) {
+    exemptedFds++;
+    return true;
+}
+
+void pltHookRegister(dev_t, ino_t, const char*, void*, void**) {
+    pltRegistrations++;
+}
+
+bool pltHookCommit() {
+    return true;
+}
+
+int connectCompanion(void*) {
+    PauseCounting pause;
+    int fds[2];
+    CHECK(socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) == 0);
+    companionFd = fds[1];
+    companion = std::thread(Companion::FakeDeviceInfoD, fds[1]);
+    connected = true;
+    return fds[0];
+}
+
+void setOption(void*, zygisk::Option option) {
+    if (option == zygisk::DLCLOSE_MODULE_LIBRARY) {
+        dlcloseRequested = true;
+    }
+}
+
+int getModuleDir(void*) {
+    return moduleDirFd;
+}
+
+zygisk::internal::api_table table = {
+    .impl = nullptr,
+    .registerModule = registerModule,
+    .hookJniNativeMethods = hookJniNativeMethods,
+    .pltHookRegister = pltHookRegister,
+    .exemptFd = exemptFd,
+    .pltHookCommit = pltHookCommit,
+    .connectCompanion = connectCompanion,
+    .setOption = setOption,
+    .getModuleDir = getModuleDir,
+    .getFlags = nullptr,
+};
+
+// Companion 处理完本次请求后回收线程与 socket
+void finishSpawn() {
+    if (companion.joinable()) {
+        companion.join();
+        close(companionFd);
+    }
+    connected = false;
+    dlcloseRequested = false;
+    pltRegistrations = 0;
+    jniHooks = 0;
+    exemptedFds = 0;
+}
+
+} // namespace FakeZygisk
+
+namespace {
+
+constexpr const char* MODULE_DIR = "spawn_alloc_test_module";
+constexpr const char* PROFILES_FILE = "spawn_alloc_test_profiles.bin";
+constexpr const char* MATCHED_NAME = "com.example.app";
+constexpr const char* UNMATCHED_NAME = "com.other.app";
+// 只设置语言的配置, 不安装 hook
+constexpr const char* LOCALE_NAME = "com.example.locale";
+
+// 与 Zygisk 传入的 AppSpecializeArgs 布局相同: 引用成员以指针存放
+struct SpawnArgs {
+    jint* uid;
+    jint* gid;
+    jintArray* gids;
+    jint* runtimeFlags;
+    jobjectArray* rlimits;
+    jint* mountExternal;
+    jstring* seInfo;
+    jstring* niceName;
+    jstring* instructionSet;
+    jstring* appDataDir;
+    jintArray* fdsToIgnore;
+    jboolean* isChildZygote;
+    jboolean* isTopApp;
+    jobjectArray* pkgDataInfoList;
+    jobjectArray* whitelistedDataInfoList;
+    jboolean* mountDataDirs;
+    jboolean* mountStorageDirs;
+};
+static_assert(sizeof(SpawnArgs) == sizeof(zygisk::AppSpecializeArgs));
+
+AreaWriter deviceProperties;
+std::vector<uint8_t> targetIndex;
+
+// 在计数之外准备 Companion 一侧的数据: 发布到 Companion 的快照 (共享 memfd) 与模块目录中的 target 索引,
+// 以及 app 进程看到的系统属性
+void prepare() {
+    // Companion 首次应答时在后台加载真实的配置目录, 主机上存在时会替换这里发布的快照
+    CHECK(access(CONFIG_DIR, F_OK) != 0);
+    json profile = {{"name", "spawn"}, {"targets", {MATCHED_NAME}}};
+    Companion::ClassifiedProfile classified;
+    classified.buildFields.push_back({BuildFields::find("MODEL"), "Pixel 9", 0, 0});
+    classified.buildFields.push_back({BuildFields::find("SDK_INT"), "", 35, 0});
+    classified.buildFields.push_back({BuildFields::find("SUPPORTED_ABIS"), std::string("arm64-v8a\0armeabi-v7a", 21), 0, 2});
+    CHECK(Companion::parseLocaleTag("zh-Hans-CN", classified.locale));
+    classified.properties["ro.product.model"] = "Pixel 9";
+    classified.properties["ro.fdi.extra"] = "1";
+    classified.files["/proc/cpuinfo"] = "Hardware\t: tensor\n";
+    classified.kernel.release = "6.1.0";
+
+    json localeProfile = {{"name", "locale"}, {"targets", {LOCALE_NAME}}};
+    Companion::ClassifiedProfile localeOnly;
+    CHECK(Companion::parseLocaleTag("en-US", localeOnly.locale));
+
+    Companion::IndexBuilder builder;
+    Companion::IndexBuilder targetBuilder(true);
+    builder.addProfile(profile, classified);
+    targetBuilder.addProfile(profile, classified);
+    builder.addProfile(localeProfile, localeOnly);
+    targetBuilder.addProfile(localeProfile, localeOnly);
+    targetIndex = targetBuilder.finish(1);
+
+    CHECK(Companion::writeIndexFile(PROFILES_FILE, "spawn_alloc_test_profiles.bin.tmp", builder.finish(1)));
+    auto mappedIndex = std::make_unique<ProfileIndex::MappedFile>();
+    CHECK(mappedIndex->map(PROFILES_FILE));
+    auto snapshot = std::make_unique<Companion::ProfileSnapshot>();
+    snapshot->index = Companion::shareIndex(std::move(mappedIndex));
+    CHECK(snapshot->index->fd() >= 0);
+    Companion::state().profileStore.publish(std::move(snapshot));
+    unlink(PROFILES_FILE);
+
+    CHECK(mkdir(MODULE_DIR, 0700) == 0 || errno == EEXIST);
+    FakeZygisk::moduleDirFd = open(MODULE_DIR, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    CHECK(FakeZygisk::moduleDirFd >= 0);
+
+    deviceProperties.add("ro.build.version.sdk", "35");
+    deviceProperties.add("ro.product.model", "RealPhone");
+    StockProperties::attach(deviceProperties);
+}
+
+void setTargetIndex(bool present) {
+    std::string path = std::string(MODULE_DIR) + "/" + TARGET_INDEX_FILE_NAME;
+    if (present) {
+        CHECK(Companion::writeIndexFile(path.c_str(), (path + ".tmp").c_str(), targetIndex));
+    } else {
+        unlink(path.c_str());
+    }
+}
+
+void cleanup() {
+    setTargetIndex(false);
+    close(FakeZygisk::moduleDirFd);
+    rmdir(MODULE_DIR);
+}
+
+// 像 Zygisk 一样调用 preAppSpecialize, 只对模块自身计数
+size_t spawn(const char* processName, const char* throwingMember = nullptr) {
+    FakeJni::reset();
+    FakeJni::throwingMember = throwingMember;
+    jint uid = 10123;
+    jint gid = 10123;
+    jintArray gids = nullptr;
+    jint runtimeFlags = 0;
+    jobjectArray rlimits = nullptr;
+    jint mountExternal = 0;
+    jstring seInfo = nullptr;
+    jstring niceName = FakeJni::newString(processName, true);
+    jstring instructionSet = nullptr;
+    jstring appDataDir = nullptr;
+    jboolean isChildZygote = JNI_FALSE;
+    SpawnArgs args = {&uid, &gid, &gids, &runtimeFlags, &rlimits, &mountExternal, &seInfo, &niceName,
+                      &instructionSet, &appDataDir, nullptr, &isChildZygote, nullptr, nullptr, nullptr, nullptr, nullptr};
+
+    allocations = 0;
+    counting = true;
+    FakeZygisk::module->preAppSpecialize(FakeZygisk::module->impl, reinterpret_cast<zygisk::AppSpecializeArgs*>(&args));
+    counting = false;
+    fprintf(stderr, "%s: spawn 路径堆分配次数 %zu\n", processName, allocations);
+    return allocations;
+}
+
+const FakeJni::Member* buildField(const char* className, const char* name) {
+    const FakeJni::Member* field = FakeJni::findMember(className, name);
+    return field && field->isField ? field : nullptr;
+}
+
+// 确认替换生效, 否则下面的零分配断言没有意义
+void testCounterSeesAllocations() {
+    counting = true;
+    void* volatile block = malloc(32);
+    std::string* volatile string = new std::string(64, 'x');
+    counting = false;
+    delete string;
+    free(block);
+    CHECK(allocations >= 3);
+    allocations = 0;
+}
+
+// target 索引未命中: 不连接 Companion, 不解析任何 JNI 字段, 随后卸载模块
+void testUnmatchedSpawn() {
+    setTargetIndex(true);
+    CHECK(spawn(UNMATCHED_NAME) == 0);
+    CHECK(!FakeZygisk::connected && FakeZygisk::dlcloseRequested);
+    CHECK(FakeJni::memberCount == 0);
+    FakeZygisk::finishSpawn();
+}
+
+// 没有 target 索引时交由 Companion 判断; 未匹配的进程同样不解析 JNI 字段
+void testSpawnWithoutTargetIndex() {
+    setTargetIndex(false);
+    CHECK(spawn(UNMATCHED_NAME) == 0);
+    CHECK(FakeZygisk::connected && FakeZygisk::dlcloseRequested);
+    CHECK(FakeJni::memberCount == 0);
+    FakeZygisk::finishSpawn();
+}
+
+// 设置语言的每一步抛出异常时都立即放弃, 不带着未处理的异常发出后续调用
+void testLocaleExceptions() {
+    setTargetIndex(true);
+    CHECK(spawn(LOCALE_NAME) == 0);
+    const FakeJni::Member* setDefaultList = FakeJni::findMember("android/os/LocaleList", "setDefault");
+    CHECK(setDefaultList && setDefaultList->invocations == 1);
+    CHECK(FakeJni::callsWithPendingException == 0);
+    CHECK(FakeZygisk::dlcloseRequested);
+    FakeZygisk::finishSpawn();
+
+    const char* throwingMembers[] = {
+        "NewStringUTF",
+        "java/util/Locale.<init>",
+        "java/util/Locale.setDefault",
+        "android/os/LocaleList.<init>",
+        "android/os/LocaleList.setDefault",
+    };
+    for (const char* throwing : throwingMembers) {
+        CHECK(spawn(LOCALE_NAME, throwing) == 0);
+        CHECK(FakeJni::callsWithPendingException == 0 && !FakeJni::pending);
+        // 只有它自己抛出时 LocaleList.setDefault 才会被调用
+        bool reached = strcmp(throwing, "android/os/LocaleList.setDefault") == 0;
+        setDefaultList = FakeJni::findMember("android/os/LocaleList", "setDefault");
+        CHECK((setDefaultList ? setDefaultList->invocations : 0) == (reached ? 1u : 0u));
+        FakeZygisk::finishSpawn();
+    }
+}
+
+// 匹配的进程: 经共享 memfd 取得配置, 写入 Build 字段, 设置语言, 安装属性/文件/uname hook 并保持常驻.
+// 本用例之后模块常驻, 须放在最后
+void testMatchedSpawn() {
+    setTargetIndex(true);
+    CHECK(spawn(MATCHED_NAME) == 0);
+    CHECK(FakeZygisk::connected && !FakeZygisk::dlcloseRequested);
+
+    const FakeJni::Member* model = buildField("android/os/Build", "MODEL");
+    CHECK(model && model->writes == 1 && strcmp(model->value, "Pixel 9") == 0);
+    const FakeJni::Member* sdk = buildField("android/os/Build$VERSION", "SDK_INT");
+    CHECK(sdk && sdk->writes == 1 && sdk->number == 35);
+    const FakeJni::Member* abis = buildField("android/os/Build", "SUPPORTED_ABIS");
+    CHECK(abis && strcmp(abis->value, "arm64-v8a,armeabi-v7a") == 0);
+
+    const FakeJni::Member* forLanguageTag = FakeJni::findMember("java/util/Locale", "forLanguageTag");
+    CHECK(forLanguageTag && forLanguageTag->invocations == 1);
+    const FakeJni::Member* setDefaultList = FakeJni::findMember("android/os/LocaleList", "setDefault");
+    CHECK(setDefaultList && setDefaultList->invocations == 1);
+    CHECK(FakeJni::callsWithPendingException == 0);
+
+    // 主机上的共享库都带版本后缀, 不会被注册; 这里只确认 hook 已登记且按 ELF 逐个注册
+    CHECK(FakeZygisk::jniHooks == 5 && PltHooks::hookCount > 0);
+    CHECK(FakeZygisk::pltRegistrations == PltHooks::hookCount * PltHooks::hookedElfCount);
+    CHECK(PropertyHooks::overrides.findProperty("ro.product.model") != nullptr);
+    CHECK(FileHooks::files.findFile("/proc/cpuinfo") != nullptr);
+    CHECK(FakeZygisk::exemptedFds == 1 && FileHooks::sharedFdCount == 1 && FileHooks::sharedFds[0] >= 0);
+    FakeZygisk::finishSpawn();
+}
+
+// 每次打开都重新打开常驻的 memfd: 偏移互不影响, 链接名不含原路径
+void testVirtualFileReopen() {
+    constexpr std::string_view content = "Hardware\t: tensor\n";
+    int first = FileHooks::openVirtual("/proc/cpuinfo", O_RDONLY | O_CLOEXEC);
+    int second = FileHooks::openVirtual("/proc/cpuinfo", O_RDONLY | O_CLOEXEC);
+    CHECK(first >= 0 && second >= 0 && first != second && first != FileHooks::sharedFds[0]);
+
+    char buffer[64];
+    CHECK(read(first, buffer, 8) == 8 && std::string_view(buffer, 8) == content.substr(0, 8));
+    CHECK(read(second, buffer, sizeof(buffer)) == static_cast<ssize_t>(content.size()));
+    CHECK(std::string_view(buffer, content.size()) == content);
+    CHECK(write(second, "x", 1) < 0);
+
+    char link[64] = {};
+    std::string fdPath = "/proc/self/fd/" + std::to_string(first);
+    CHECK(readlink(fdPath.c_str(), link, sizeof(link) - 1) > 0);
+    CHECK(strstr(link, "cpuinfo") == nullptr);
+    close(first);
+    close(second);
+
+    // 常驻的 memfd 不可用时为本次打开单独创建
+    int shared = FileHooks::sharedFds[0];
+    FileHooks::sharedFds[0] = -1;
+    int fallback = FileHooks::openVirtual("/proc/cpuinfo", O_RDONLY);
+    FileHooks::sharedFds[0] = shared;
+    CHECK(fallback >= 0 && read(fallback, buffer, sizeof(buffer)) == static_cast<ssize_t>(content.size()));
+    close(fallback);
+}
+
+void testReadNiceNameRejectsInvalidNames() {
+    JNIEnv env;
+    char buffer[8];
+    jstring fits = FakeJni::newString("1234567");
+    jstring tooLong = FakeJni::newString("12345678");
+    jstring empty = FakeJni::newString("");
+    CHECK(readNiceName(&env, fits, buffer) && strcmp(buffer, "1234567") == 0);
+    CHECK(!readNiceName(&env, tooLong, buffer));
+    CHECK(!readNiceName(&env, empty, buffer));
+    CHECK(!readNiceName(&env, nullptr, buffer));
+}
+
+} // namespace
+
+int main() {
+    testCounterSeesAllocations();
+    prepare();
+    JNIEnv env;
+    zygisk_module_entry(&FakeZygisk::table, &env);
+    CHECK(FakeZygisk::module != nullptr);
+
+    testUnmatchedSpawn();
+    testSpawnWithoutTargetIndex();
+    testLocaleExceptions();
+    testMatchedSpawn();
+    testVirtualFileReopen();
+    cleanup();
+    testReadNiceNameRejectsInvalidNames();
+    return 0;
+}
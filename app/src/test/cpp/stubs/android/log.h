@@ -0,0 +1,20 @@
+#ifndef HOST_STUB_ANDROID_LOG_H
+#define HOST_STUB_ANDROID_LOG_H
+
+#include <cstdarg>
+#include <cstdio>
+
+// 主机测试用: 日志写到 stderr
+enum { ANDROID_LOG_DEBUG = 3, ANDROID_LOG_INFO, ANDROID_LOG_WARN, ANDROID_LOG_ERROR };
+
+extern "C" inline int __android_log_print(int, const char* tag, const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    fprintf(stderr, "%s: ", tag);
+    int written = vfprintf(stderr, format, args);
+    fputc('\n', stderr);
+    va_end(args);
+    return written;
+}
+
+#endif // HOST_STUB_ANDROID_LOG_H
@@ -0,0 +1,80 @@
+#ifndef HOST_STUB_JNI_H
+#define HOST_STUB_JNI_H
+
+#include <cstdarg>
+#include <cstdint>
+
+// 主机测试用: 只声明模块用到的 JNI 类型与 JNIEnv 方法, 用到的测试自行提供实现
+typedef uint8_t jboolean;
+typedef int8_t jbyte;
+typedef uint16_t jchar;
+typedef int16_t jshort;
+typedef int32_t jint;
+typedef int64_t jlong;
+typedef float jfloat;
+typedef double jdouble;
+typedef jint jsize;
+
+class _jobject {};
+class _jclass : public _jobject {};
+class _jstring : public _jobject {};
+class _jarray : public _jobject {};
+class _jobjectArray : public _jarray {};
+class _jintArray : public _jarray {};
+typedef _jobject* jobject;
+typedef _jclass* jclass;
+typedef _jstring* jstring;
+typedef _jarray* jarray;
+typedef _jobjectArray* jobjectArray;
+typedef _jintArray* jintArray;
+
+struct _jfieldID;
+typedef _jfieldID* jfieldID;
+struct _jmethodID;
+typedef _jmethodID* jmethodID;
+
+typedef struct {
+    const char* name;
+    const char* signature;
+    void* fnPtr;
+} JNINativeMethod;
+
+#define JNI_TRUE 1
+#define JNI_FALSE 0
+
+struct _JNIEnv {
+    jclass FindClass(const char*);
+    jboolean ExceptionCheck();
+    void ExceptionClear();
+    void DeleteLocalRef(jobject);
+    jobject NewGlobalRef(jobject);
+    jobject NewLocalRef(jobject);
+    void DeleteGlobalRef(jobject);
+    jboolean IsSameObject(jobject, jobject);
+    jfieldID GetStaticFieldID(jclass, const char*, const char*);
+    jmethodID GetStaticMethodID(jclass, const char*, const char*);
+    jmethodID GetMethodID(jclass, const char*, const char*);
+    jobject GetStaticObjectField(jclass, jfieldID);
+    void SetStaticObjectField(jclass, jfieldID, jobject);
+    void SetStaticIntField(jclass, jfieldID, jint);
+    void SetStaticLongField(jclass, jfieldID, jlong);
+    void SetStaticBooleanField(jclass, jfieldID, jboolean);
+    jobject NewObject(jclass, jmethodID, ...);
+    jobject CallStaticObjectMethod(jclass, jmethodID, ...);
+    void CallStaticVoidMethod(jclass, jmethodID, ...);
+    jobject CallObjectMethod(jobject, jmethodID, ...);
+    void CallVoidMethod(jobject, jmethodID, ...);
+    jstring NewStringUTF(const char*);
+    jsize GetStringLength(jstring);
+    jsize GetStringUTFLength(jstring);
+    const char* GetStringUTFChars(jstring, jboolean*);
+    void ReleaseStringUTFChars(jstring, const char*);
+    void GetStringUTFRegion(jstring, jsize, jsize, char*);
+    jobjectArray NewObjectArray(jsize, jclass, jobject);
+    jint PushLocalFrame(jint);
+    jobject PopLocalFrame(jobject);
+    void SetObjectArrayElement(jobjectArray, jsize, jobject);
+};
+typedef _JNIEnv JNIEnv;
+
+#endif // HOST_STUB_JNI_H
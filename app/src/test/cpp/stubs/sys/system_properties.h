@@ -0,0 +1,22 @@
+#ifndef HOST_STUB_SYS_SYSTEM_PROPERTIES_H
+#define HOST_STUB_SYS_SYSTEM_PROPERTIES_H
+
+#include <cstdint>
+
+// 主机测试用: 只有声明, 用到的测试自行提供实现
+#define PROP_VALUE_MAX 92
+#define PROP_NAME_MAX 32
+
+extern "C" {
+typedef struct prop_info prop_info;
+int __system_property_get(const char* name, char* value);
+const prop_info* __system_property_find(const char* name);
+int __system_property_read(const prop_info* pi, char* name, char* value);
+void __system_property_read_callback(const prop_info* pi,
+                                     void (*callback)(void* cookie, const char* name, const char* value,
+                                                      uint32_t serial),
+                                     void* cookie);
+int __system_property_foreach(void (*callback)(const prop_info* pi, void* cookie), void* cookie);
+}
+
+#endif // HOST_STUB_SYS_SYSTEM_PROPERTIES_H
@@ -0,0 +1,75 @@
+#include "test_support.hpp"
+#include "bench_support.hpp"
+#include "fake_jni.hpp"
+#include "property_fixture.hpp"
+#include "property_hooks.hpp"
+
+// SystemProperties.native_get: 原方法与替换后命中/未命中覆盖表的开销对比, 以及 findJavaValue 本身.
+// JNIEnv 为主机上的最小实现, 字符串的创建与复制比 ART 便宜, 结果只反映本模块增加的部分
+namespace {
+
+constexpr size_t OVERRIDE_COUNT = 40;
+
+// 与 framework 的 SystemProperties_getSS 相同的步骤: 取键名副本, 查找并读取属性, 创建返回的字符串
+jstring stockNativeGet(JNIEnv* env, jclass, jstring key) {
+    const char* name = env->GetStringUTFChars(key, nullptr);
+    char value[PROP_VALUE_MAX];
+    StockProperties::get(name, value);
+    env->ReleaseStringUTFChars(key, name);
+    return env->NewStringUTF(value);
+}
+
+} // namespace
+
+int main() {
+    AreaWriter area(512 * 1024);
+    std::vector<std::string> all = fillTypicalProperties(area);
+    StockProperties::attach(area);
+
+    // 键作为全局引用常驻, 不会被 DeleteLocalRef 释放
+    std::vector<jstring> hits;
+    std::vector<jstring> misses;
+    Companion::ClassifiedProfile classified;
+    for (size_t i = 0; i < all.size(); i++) {
+        if (i % (all.size() / OVERRIDE_COUNT) == 0 && hits.size() < OVERRIDE_COUNT) {
+            classified.properties[all[i]] = std::to_string(i);
+            hits.push_back(FakeJni::newString(all[i], true));
+        } else {
+            misses.push_back(FakeJni::newString(all[i], true));
+        }
+    }
+    ProfileFixture profile = buildProfile(classified);
+
+    JNIEnv env;
+    PropertyHooks::overrides = profile.view;
+    CHECK(PropertyHooks::prepareJavaValues(&env));
+    PropertyHooks::originalNativeGet = stockNativeGet;
+
+    jstring spoofed = PropertyHooks::hookedNativeGet(&env, nullptr, hits[1]);
+    CHECK(FakeJni::text(spoofed) == std::to_string(all.size() / OVERRIDE_COUNT));
+    jstring real = PropertyHooks::hookedNativeGet(&env, nullptr, misses[1]);
+    CHECK(FakeJni::text(real).starts_with("value"));
+    env.DeleteLocalRef(real);
+    CHECK(PropertyHooks::hookedNativeGetInt(&env, nullptr, hits[1], -1) ==
+          static_cast<jint>(all.size() / OVERRIDE_COUNT));
+
+    size_t iterations = benchIterations(50000);
+    auto call = [&](auto get, const std::vector<jstring>& keys) {
+        return [&, get](size_t i) {
+            jstring result = get(&env, nullptr, keys[i % keys.size()]);
+            keep(result);
+            env.DeleteLocalRef(result);
+        };
+    };
+    measure("native_get 原方法 (被覆盖的键)", iterations, call(stockNativeGet, hits));
+    measure("native_get 替换后命中", iterations, call(PropertyHooks::hookedNativeGet, hits));
+    measure("native_get 原方法 (未覆盖的键)", iterations, call(stockNativeGet, misses));
+    measure("native_get 替换后未命中", iterations, call(PropertyHooks::hookedNativeGet, misses));
+    measure("findJavaValue 命中", iterations, [&](size_t i) {
+        keep(PropertyHooks::findJavaValue(&env, hits[i % hits.size()]));
+    });
+    measure("findJavaValue 未命中", iterations, [&](size_t i) {
+        keep(PropertyHooks::findJavaValue(&env, misses[i % misses.size()]));
+    });
+    return 0;
+}
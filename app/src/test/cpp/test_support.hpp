@@ -0,0 +1,16 @@
+#ifndef TEST_SUPPORT_HPP
+#define TEST_SUPPORT_HPP
+
+#include <cstdio>
+#include <cstdlib>
+
+// 主机测试不依赖测试框架; 任何检查失败即以非零状态退出, 由 ctest 报告
+#define CHECK(condition)                                                                  \
+    do {                                                                                  \
+        if (!(condition)) {                                                               \
+            fprintf(stderr, "%s:%d: CHECK(%s) 失败\n", __FILE__, __LINE__, #condition);   \
+            std::exit(1);                                                                 \
+        }                                                                                 \
+    } while (0)
+
+#endif // TEST_SUPPORT_HPP
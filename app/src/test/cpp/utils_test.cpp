@@ -0,0 +1,51 @@
+#include "test_support.hpp"
+#include "utils.hpp"
+
+namespace {
+
+constexpr const char* LINES_FILE = "utils_test_lines.txt";
+
+void writeFile(const char* path, const std::string& content) {
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    CHECK(fd >= 0 && safeWrite(fd, content.data(), content.size()));
+    close(fd);
+}
+
+// 跨越读缓冲区边界的行, 超长行的截断, 以及没有换行符的最后一行
+void testLineReader() {
+    std::string longLine(5000, 'x');
+    writeFile(LINES_FILE, "first\n\n" + longLine + "\nafter long\nlast");
+
+    LineReader reader(LINES_FILE);
+    CHECK(reader.valid());
+    char line[64];
+    CHECK(reader.next(line, sizeof(line)) && strcmp(line, "first") == 0);
+    CHECK(reader.next(line, sizeof(line)) && line[0] == '\0');
+    CHECK(reader.next(line, sizeof(line)) && strlen(line) == sizeof(line) - 1 && line[0] == 'x');
+    CHECK(reader.next(line, sizeof(line)) && strcmp(line, "after long") == 0);
+    CHECK(reader.next(line, sizeof(line)) && strcmp(line, "last") == 0);
+    CHECK(!reader.next(line, sizeof(line)));
+    unlink(LINES_FILE);
+
+    LineReader missing("utils_test_missing.txt");
+    CHECK(!missing.valid() && !missing.next(line, sizeof(line)));
+}
+
+// 本测试程序自身的映射: 至少有代码段常驻
+void testElfFootprint() {
+    MappingFootprint footprint;
+    CHECK(readElfFootprint(reinterpret_cast<const void*>(&testElfFootprint), footprint));
+    CHECK(footprint.size > 0 && footprint.rss > 0 && footprint.rss <= footprint.size);
+    CHECK(footprint.privateClean + footprint.privateDirty <= footprint.rss);
+
+    int local = 0;
+    CHECK(!readElfFootprint(&local, footprint));
+}
+
+} // namespace
+
+int main() {
+    testLineReader();
+    testElfFootprint();
+    return 0;
+}
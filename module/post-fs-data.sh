@@ -0,0 +1,4 @@
+MODDIR=${0%/*}
+
+# target 索引由 Companion 在首次连接后重新发布, 开机时清除上次启动遗留的索引
+rm -f "$MODDIR/targets.bin" "$MODDIR/targets.bin.tmp"